@@ -20,11 +20,48 @@
  * THE SOFTWARE.
  */
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cctype>
+#include <climits>
+#include <cmath>
+#include <condition_variable>
+#include <cerrno>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
 #include <functional>
+#include <iterator>
+#include <limits>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
 #include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#endif
 
 #include "ctfOverseerAPI.h"
+#include "ctfOverseerCaptureLog.h"
+#include "ctfOverseerScoreboard.h"
+#include "ctfOverseerScoring.h"
 
 #include "bzfsAPI.h"
 #include "plugin_utils.h"
@@ -32,464 +69,6070 @@
 // Define plugin name
 const std::string PLUGIN_NAME = "CTF Overseer";
 
+// The section of the configuration file this plug-in reads
+const char* const CONFIG_SECTION = "ctfOverseer";
+
 // Define plugin version numbering
 const int MAJOR = 1;
-const int MINOR = 1;
-const int REV = 2;
-const int BUILD = 34;
+const int MINOR = 2;
+const int REV = 0;
+const int BUILD = 35;
 
 // Plugin settings
-const int RECALC_INTERVAL = 20; /// The number of seconds between a flag drop and point bonus point recalculation
-const int SELF_CAP_MULTIPLIER = 5; /// The pentality multiplier for self-caps; this number times the current team size
-const int MESSAGE_SPAM_INTERVAL = 5; /// The number of seconds between a message should be sent to prevent spamming players
 const int VERBOSE_DEBUG_LEVEL = 4; /// The debug level that verbose messages will be written out at
+const int DEFAULT_MESSAGES_PER_TICK = 20; /// The number of queued messages sent per server tick unless overridden in the configuration file
+const size_t OUTBOX_CAPACITY = 4096; /// The most messages that may wait to be sent before older ones are dropped; must be a power of two
+const float TICK_INTERVAL = 0.1f; /// The longest time, in seconds, bzfs may wait between ticks; also the resolution of flag timers
+const size_t FLAG_TIMER_SLOTS = 256; /// Buckets in the team flag timer wheel, covering 25.6 seconds per revolution; must be a power of two
+const int LATENCY_SAMPLE_INTERVAL = 16; /// Only one in this many events reads the clock for the /ctfstats latency histograms; must be a power of two
+const uint32_t DEFAULT_CAPTURE_LOG_SEGMENT_RECORDS = 65536; /// The number of records in each capture log segment (2 MiB) unless overridden in the configuration file
+const int DEFAULT_ASYNC_LISTENER_THREADS = 2; /// Worker threads for asynchronous capture listeners unless overridden in the configuration file
+const int DEFAULT_ASYNC_LISTENER_QUEUE_SIZE = 1024; /// Capture events each async listener worker can hold before new ones are dropped
+const int MAX_ASYNC_LISTENER_QUEUE_SIZE = 1 << 20;
+const size_t TRACE_BUFFER_EVENTS = 16384; /// Spans kept per thread while tracing, 512 KiB each; must be a power of two
+const double DEFAULT_TRACE_DUMP_SECONDS = 10; /// The window /ctftrace dump writes out unless given one
+const size_t MAX_LOCALES = 32; /// Message catalogs that may be loaded at once, the default one included
+const char* const DEFAULT_LOCALE_NAME = "en"; /// The name of the locale in the plug-in's own section unless `default_locale` is set
+const double DEFAULT_PLAYER_STATS_FLUSH_INTERVAL = 30; /// Seconds between player stats flushes unless overridden in the configuration file
+const size_t PLAYER_STATS_TOP_COUNT = 5; /// The number of players listed by /ctftop
+const size_t PLAYER_STATS_COMPACT_RATIO = 4; /// The player stats file is rewritten from the totals once it has this many lines per callsign
 
-typedef std::map<std::string, std::string> StringDict;
+// State store sizing
+const int TEAM_SLOTS = ePurpleTeam + 1; /// Enough slots to index every team that owns a team flag directly by bz_eTeamType
+const int MAX_PLAYER_SLOTS = 256; /// Player IDs are a single byte on the wire, so this covers every possible slot
+const double NEVER = -std::numeric_limits<double>::infinity(); /// The timestamp used for events that have not happened yet
 
-struct Configuration
+// State snapshot format
+const uint32_t STATE_SNAPSHOT_MAGIC = 0x534F5443; /// "CTOS"
+const uint32_t STATE_SNAPSHOT_VERSION = 2;
+
+/// The placeholders that may be used in templated messages
+enum class Placeholder
+{
+    Capper,
+    TeamCapping,
+    TeamCapped,
+    Points,
+    PointsAbs,
+    GrabDelay,
+    CooldownRemaining,
+    TeamCappingSize,
+    TeamCappedSize,
+    Count
+};
+
+/// Indexed by Placeholder
+const char* const PLACEHOLDER_NAMES[(size_t)Placeholder::Count] = {
+    "{capper}",
+    "{teamCapping}",
+    "{teamCapped}",
+    "{points}",
+    "{pointsAbs}",
+    "{grabDelay}",
+    "{cooldownRemaining}",
+    "{teamCappingSize}",
+    "{teamCappedSize}",
+};
+
+/// The evaluated value of each placeholder, indexed by Placeholder
+typedef std::array<std::string, (size_t)Placeholder::Count> PlaceholderValues;
+
+/// Every message the plug-in sends to players, each of which may be translated
+enum class MessageID
 {
-    std::string SelfCapturePublicMessage;
-    std::string SelfCapturePrivateMessage;
+    SelfCapturePublic,
+    SelfCapturePrivate,
+    FairCapturePublic,
+    FairCapturePrivate,
+    UnfairCapturePublic,
+    UnfairCapturePrivate,
+    FlagAvailablePublic,
+    CooldownNotice,
+    UnfairTeamWarning,
+    UnfairCaptureNotice,
+    Count
+};
 
-    std::string FairCapturePublicMessage;
-    std::string FairCapturePrivateMessage;
+const size_t MESSAGE_COUNT = (size_t)MessageID::Count;
 
-    std::string UnfairCapturePublicMessage;
-    std::string UnfairCapturePrivateMessage;
+struct MessageDefinition
+{
+    const char* key; /// The configuration key the message is read from, in the plug-in's section and in locale sections
+    const char* fallback; /// Used by the default locale when the key isn't set; an empty message is never sent
 };
 
-class CTFOverseer : public bz_Plugin, public bz_CustomSlashCommandHandler
+/// Indexed by MessageID
+const MessageDefinition MESSAGE_DEFINITIONS[MESSAGE_COUNT] = {
+    {"self_cap_message_pub", ""},
+    {"self_cap_message_pm", ""},
+    {"fair_cap_message_pub", ""},
+    {"fair_cap_message_pm", ""},
+    {"unfair_cap_message_pub", ""},
+    {"unfair_cap_message_pm", ""},
+    {"flag_available_message_pub", ""},
+    {"cooldown_notice_message", "Team flags cannot be grabbed for {grabDelay} seconds after they were last capped; you cannot grab the {teamCapped} team flag for another ~{cooldownRemaining} seconds."},
+    {"unfair_team_message", "{teamCappingSize} vs {teamCappedSize}? Don't be a bad sport."},
+    {"unfair_cap_notice_message", "Unfair flag captures are disabled, your flag has been taken."},
+};
+
+/// An index into a MessageCatalog's locales
+typedef uint8_t LocaleID;
+
+const LocaleID DEFAULT_LOCALE = 0;
+const LocaleID NO_LOCALE = UINT8_MAX; /// Marks player slots nobody is using
+
+static_assert(MAX_LOCALES < NO_LOCALE, "Locale IDs must fit in a LocaleID without colliding with NO_LOCALE");
+
+/// Every message in every locale, split into literal spans and placeholder slots when the configuration is loaded. The
+/// text of all templates lives in one contiguous arena where identical templates are stored once, and the table has an
+/// entry for every (locale, message) pair with missing translations already pointing at the default locale's, so
+/// rendering a message never looks anything up by name.
+class MessageCatalog
 {
 public:
-    const char* Name();
-    void Init(const char* config);
-    void Cleanup();
-    void Event(bz_EventData* eventData);
-    int GeneralCallback(const char* name, void* data);
-    bool SlashCommand(int playerID, bz_ApiString command, bz_ApiString message, bz_APIStringList *params);
+    /// Start a catalog with only the default locale, holding the fallback messages
+    MessageCatalog();
+    explicit MessageCatalog(const std::string &defaultLocale);
+
+    LocaleID addLocale(const std::string &name);
+    void set(LocaleID locale, MessageID message, const std::string &raw);
+    void finish();
+
+    size_t locales() const;
+    const std::string& localeName(LocaleID locale) const;
+    LocaleID findLocale(const std::string &name) const;
+    std::string raw(LocaleID locale, MessageID message) const;
+    size_t arenaSize() const;
+
+    bool empty(LocaleID locale, MessageID message) const
+    {
+        return entries[locale * MESSAGE_COUNT + (size_t)message].tokenCount == 0;
+    }
+
+    void render(LocaleID locale, MessageID message, const PlaceholderValues &values, std::string &output) const;
 
 private:
-    void loadConfigurationFile();
-    void safeSendMessage(const std::string msg, int recipient, StringDict placeholders);
-    void formatString(bz_ApiString &string, StringDict placeholders);
+    struct Token
+    {
+        int32_t placeholder; /// The Placeholder this token is replaced with or -1 when it's a literal span
+        uint32_t offset;     /// The starting position of a literal span in `arena`
+        uint32_t length;     /// The length of a literal span in `arena`
+    };
 
-    bool isFairCapture(bz_eTeamType capping, bz_eTeamType capped);
-    int calcCapturePoints(bz_eTeamType capping, bz_eTeamType capped);
+    struct Entry
+    {
+        uint32_t source;       /// Where the template's raw text starts in `arena`
+        uint32_t sourceLength;
+        uint32_t firstToken;   /// Index of the template's first token in `tokens`
+        uint32_t tokenCount;   /// 0 for an empty template
+        bool defined;          /// Whether the locale set this message itself
+    };
 
-    Configuration settings;
+    Entry intern(const std::string &raw);
 
-    std::map<bz_eTeamType, double> lastCapTime; /// The server time when a team was last capped on
-    std::map<bz_eTeamType, int> capBonus; /// The number of points a capture will be worth against this team
-    std::map<int, double> lastFlagDrop; /// The server time a team flag was last dropped
-    std::map<int, double> lastFlagWarnMsg; /// The server time a warning was sent to a player trying to grab a team flag
+    std::string arena;
+    std::vector<Token> tokens;
+    std::vector<Entry> entries; /// Indexed by [locale * MESSAGE_COUNT + message]
+    std::vector<std::string> localeNames;
+    std::map<std::string, Entry> interned; /// Templates seen so far; only used while the catalog is being built
+};
 
-    int onCaptureEventListenersCounter;
-    std::map<int, OnCaptureEventCallbackV1> onCaptureEventListeners;
+static_assert(TEAM_SLOTS == CTFOVERSEER_TEAM_SLOTS, "The team slots in the public API must match the plug-in's");
+static_assert(TEAM_SLOTS == SCOREBOARD_TEAMS, "The teams in the shared memory scoreboard must match the plug-in's");
 
-    const char* bzdb_delayTeamFlagGrab = "_delayTeamFlagGrab";
-    const char* bzdb_disallowSelfCap = "_disallowSelfCap";
-    const char* bzdb_disallowUnfairCap = "_disallowUnfairCap";
-    const char* bzdb_maxCapBonus = "_maxCapBonus";
-    const char* bzdb_warnUnfairTeams = "_warnUnfairTeams";
+/// A typed copy of our custom BZDB variables that is only refreshed when one of them changes
+struct BZDBSettings
+{
+    int delayTeamFlagGrab; /// `_delayTeamFlagGrab`; only meaningful when `delayTeamFlagGrabEnabled` is true
+    bool delayTeamFlagGrabEnabled; /// False when `_delayTeamFlagGrab` is negative, allowing immediate grabs after a capture
+    int maxCapBonus; /// `_maxCapBonus`, clamped to be non-negative
+    bool disallowSelfCap; /// `_disallowSelfCap`
+    bool disallowUnfairCap; /// `_disallowUnfairCap`
+    bool warnUnfairTeams; /// `_warnUnfairTeams`
+    double teamSizeDecayWindow; /// `_teamSizeDecayWindow`, clamped to be non-negative; 0 scores captures with the current team sizes
+};
 
-    bz_ApiString configFile;
+/// A square table of values indexed by [capping team][capped team]
+typedef std::array<std::array<int, TEAM_SLOTS>, TEAM_SLOTS> TeamMatrix;
+
+/// The number of players on each team, maintained from player events instead of being queried from bzfs
+struct TeamRoster
+{
+    std::array<bz_eTeamType, MAX_PLAYER_SLOTS> playerTeam; /// The team each player slot belongs to
+    std::array<int, TEAM_SLOTS> teamSize; /// The number of players on each team
+
+    void reset();
+    bool setPlayerTeam(int playerID, bz_eTeamType team);
+    int size(bz_eTeamType team) const;
 };
 
-BZ_PLUGIN(CTFOverseer)
+/// Team sizes that follow the roster with an exponential delay, so switching teams right before a capture barely moves
+/// them. Between roster changes a team's size approaches its player count in closed form, so only the value at the last
+/// change is stored and both updating and querying a team are O(1).
+struct DecayedTeamSizes
+{
+    std::array<double, TEAM_SLOTS> weighted; /// The decayed size as of `since`
+    std::array<int, TEAM_SLOTS> target;      /// The number of players on the team since `since`
+    std::array<double, TEAM_SLOTS> since;
+    double window = 0; /// The time constant, in seconds; sizes aren't decayed while this is 0
 
-const char* CTFOverseer::Name()
+    void reset(const TeamRoster &roster, double now);
+    void setWindow(double seconds, const TeamRoster &roster, double now);
+    void sync(const TeamRoster &roster, double now);
+    double size(int team, double now) const;
+};
+
+/// Runtime state for teams, players and flags kept in fixed slots so lookups are O(1) and never insert anything
+struct StateStore
 {
-    static const char* pluginBuild;
+    std::array<double, TEAM_SLOTS> lastCapTime; /// The server time when a team was last capped on
+    TeamMatrix capBonus; /// The number of points a capture will be worth, locked in when a team grabbed the enemy flag
+    std::array<double, TEAM_SLOTS> lastFlagDrop; /// The server time a team's flag was last dropped by an enemy
 
-    if (!pluginBuild)
+    void reset();
+
+    bool writeSnapshot(const std::string &path, double now) const;
+    bool restoreSnapshot(const std::vector<uint8_t> &snapshot, double now);
+};
+
+/// The fixed layout of a state snapshot file. Times are stored as server times along with the server and wall clock time
+/// of the save so they can be rebased onto a new server's clock.
+struct StateSnapshotHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t teamSlots;
+    double savedServerTime;
+    int64_t savedWallTime;
+    double lastCapTime[TEAM_SLOTS];
+    double lastFlagDrop[TEAM_SLOTS];
+    int32_t capBonus[TEAM_SLOTS][TEAM_SLOTS];
+};
+
+/// A hashed timer wheel. Timers are bucketed by the tick they expire on, so advancing only visits the buckets of the ticks
+/// that passed; timers more than one revolution away wait in their bucket until their round comes up. Timer IDs are
+/// small integers chosen by the owner, and scheduling an ID that is already pending moves it. Buckets are intrusive lists
+/// threaded through the timers, so nothing is allocated once every ID has been seen.
+class TimerWheel
+{
+public:
+    TimerWheel(double resolution, size_t slotCount);
+
+    void reset(double now);
+    void schedule(int timerID, double when);
+    void cancel(int timerID);
+
+    /// Call `expired(timerID)` for every timer due at or before `now`, in no particular order
+    template <typename Callback>
+    void advance(double now, Callback &&expired);
+
+private:
+    struct Timer
     {
-        pluginBuild = bz_format("%s %d.%d.%d (%d)", PLUGIN_NAME.c_str(), MAJOR, MINOR, REV, BUILD);
+        int64_t tick; /// The tick the timer fires on
+        int prev;     /// The previous timer in the same bucket, or -1
+        int next;     /// The next timer in the same bucket, or -1
+        bool active;  /// Whether the timer is linked into a bucket
+    };
+
+    int64_t tickOf(double time) const;
+    void link(int timerID);
+    void unlink(int timerID);
+
+    double resolution;
+    size_t slotMask;
+    int64_t currentTick;
+    std::vector<int> slots;    /// The first timer ID in each bucket, or -1
+    std::vector<Timer> timers; /// Indexed by timer ID
+    std::vector<int> due;      /// Reused between advances; never needs more room than `timers`
+};
+
+template <typename Callback>
+void TimerWheel::advance(double now, Callback &&expired)
+{
+    int64_t target = (int64_t)std::floor(now / resolution);
+
+    if (target <= currentTick)
+    {
+        return;
     }
 
-    return pluginBuild;
+    // After a long stall every bucket only needs to be visited once
+    int64_t first = std::max(currentTick + 1, target - (int64_t)slotMask);
+    due.clear();
+
+    for (int64_t tick = first; tick <= target; tick++)
+    {
+        int timerID = slots[tick & slotMask];
+
+        while (timerID >= 0)
+        {
+            int next = timers[timerID].next;
+
+            if (timers[timerID].tick <= target)
+            {
+                unlink(timerID);
+                due.push_back(timerID);
+            }
+
+            timerID = next;
+        }
+    }
+
+    currentTick = target;
+
+    for (int timerID : due)
+    {
+        expired(timerID);
+    }
 }
 
-void CTFOverseer::Init(const char* config)
+/// What may currently happen to a team flag
+enum class TeamFlagState
 {
-    onCaptureEventListenersCounter = 0;
-    configFile = config;
+    Available,       /// At its base or lying on the field, and grabbing it recalculates the capture bonus
+    CoolingDown,     /// Recently captured; only its own team may grab it until the cooldown ends
+    Carried,         /// Held by an enemy
+    DroppedRecently, /// Dropped by an enemy less than RECALC_INTERVAL seconds ago; grabbing it keeps the old bonus
+};
 
-    loadConfigurationFile();
+/// The state machine for every team flag. Cooldowns and drop windows end on timers advanced on bz_eTickEvent, so checking
+/// a flag is a single array read and nothing needs to be polled.
+class TeamFlagTracker
+{
+public:
+    TeamFlagTracker();
 
-    // Namespace our clip fields to avoid plug-in conflicts
-    bz_setclipFieldString("allejo/ctfOverseer", Name());
+    TeamFlagState state(bz_eTeamType team) const
+    {
+        return states[team];
+    }
 
-    Register(bz_eAllowCTFCaptureEvent);
-    Register(bz_eAllowFlagGrab);
-    Register(bz_eCaptureEvent);
-    Register(bz_eFlagGrabbedEvent);
-    Register(bz_eFlagDroppedEvent);
+    /// The server time the flag's cooldown ends; only meaningful while it's CoolingDown
+    double cooldownEnd(bz_eTeamType team) const
+    {
+        return cooldownEnds[team];
+    }
 
-    bz_registerCustomBZDBInt(bzdb_delayTeamFlagGrab, 20);
-    bz_registerCustomBZDBInt(bzdb_maxCapBonus, 9999);
-    bz_registerCustomBZDBBool(bzdb_disallowSelfCap, true);
-    bz_registerCustomBZDBBool(bzdb_disallowUnfairCap, false);
-    bz_registerCustomBZDBBool(bzdb_warnUnfairTeams, true);
+    void reset(double now);
+    void captured(bz_eTeamType team, double cooldownEndsAt, double now);
+    void grabbed(bz_eTeamType team);
+    void dropped(bz_eTeamType team, double windowEndsAt, double now);
 
-    bz_registerCustomSlashCommand("reload", this);
+    /// Call `changed(team, previousState)` for every flag whose cooldown or drop window ended
+    template <typename Callback>
+    void advance(double now, Callback &&changed)
+    {
+        timers.advance(now, [&](int timerID) {
+            bz_eTeamType team = (bz_eTeamType)timerID;
+            TeamFlagState previous = states[team];
+
+            states[team] = TeamFlagState::Available;
+            changed(team, previous);
+        });
+    }
+
+private:
+    std::array<TeamFlagState, TEAM_SLOTS> states;
+    std::array<double, TEAM_SLOTS> cooldownEnds;
+    TimerWheel timers; /// Timer IDs are team numbers; each flag has at most one pending transition
+};
+
+/// The kinds of messages sent by the plug-in; notices of the same kind to the same player are coalesced while queued
+enum class MessageClass
+{
+    CaptureAnnouncement,
+    CapturePrivate,
+    CooldownNotice,
+    UnfairTeamWarning,
+    UnfairCaptureNotice,
+    Count
+};
+
+/// The first MessageClass that is a notice to a single player rather than part of announcing a capture
+const size_t FIRST_NOTICE_CLASS = (size_t)MessageClass::CooldownNotice;
+const size_t NOTICE_CLASSES = (size_t)MessageClass::Count - FIRST_NOTICE_CLASS;
+
+/// A token bucket for one class of notices: up to `burst` at once, then one every `interval` seconds. An interval of 0
+/// disables limiting.
+struct NoticeLimit
+{
+    int burst;
+    double interval;
+};
+
+struct Configuration
+{
+    /// The default locale is read from the plug-in's section and every other one from a `[ctfOverseer.<locale>]` section.
+    /// FlagAvailablePublic is sent when a team flag's grab cooldown ends; only {teamCapped} is set for it.
+    MessageCatalog Messages;
+
+    CaptureScoring Scoring;
+
+    size_t MessagesPerTick = DEFAULT_MESSAGES_PER_TICK; /// The most queued messages sent per tick
+    std::string DebugLogFile;
+    int DebugLogLevel = VERBOSE_DEBUG_LEVEL;
+    std::string CaptureLogDir;
+    uint32_t CaptureLogSegmentRecords = DEFAULT_CAPTURE_LOG_SEGMENT_RECORDS;
+    std::string StateSnapshotFile; /// Where the runtime state is saved on Cleanup and restored from on Init
+    std::string ScoreboardName; /// The POSIX shared memory object the scoreboard is published to
+    bool AutoReload = false;
+    bool TraceEnabled = false; /// Whether spans are recorded for /ctftrace; the command may turn this on or off until the next reload
+    std::string TraceDir = "."; /// Where /ctftrace dump writes trace files
+    std::string PlayerStatsFile; /// Where per-player statistics are persisted; they aren't kept when this is empty
+    double PlayerStatsFlushInterval = DEFAULT_PLAYER_STATS_FLUSH_INTERVAL;
+    int AsyncListenerThreads = DEFAULT_ASYNC_LISTENER_THREADS; /// Only read when the first async listener is registered
+    int AsyncListenerQueueSize = DEFAULT_ASYNC_LISTENER_QUEUE_SIZE;
+
+    /// Indexed by MessageClass - FIRST_NOTICE_CLASS
+    std::array<NoticeLimit, NOTICE_CLASSES> NoticeLimits = {{
+        {1, 5.0},  // CooldownNotice
+        {2, 15.0}, // UnfairTeamWarning
+        {2, 10.0}, // UnfairCaptureNotice
+    }};
+};
+
+/// The outcome of building a Configuration on the reload thread
+struct ConfigurationLoad
+{
+    std::shared_ptr<const Configuration> config; /// NULL if the file could not be used, in which case `error` says why
+    std::string error;
+    int requestedBy; /// The player who ran /reload, or BZ_SERVER for automatic reloads
+    bool quiet; /// Don't tell `requestedBy` about a successful reload
+};
+
+/// Reads and validates the configuration file on a background thread, either on request or when the file changes, so the
+/// main thread never waits on the disk. Finished loads are published with an atomic pointer swap.
+class ConfigReloader
+{
+public:
+    ConfigReloader();
+    ~ConfigReloader();
+
+    void start(const std::string &path);
+    void stop();
+
+    void request(int playerID, bool quiet);
+    void setAutoReload(bool enabled);
+
+    /// The most recent finished load, if there is one that hasn't been taken yet
+    std::shared_ptr<const ConfigurationLoad> takeResult();
+
+private:
+    void run();
+    void notify();
+    bool waitForChange();
+    void updateWatch();
+    bool fileChanged();
+
+    std::string filePath;
+    std::string fileDirectory;
+    std::string fileName;
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake; /// Wakes the worker when there's no `wakeFD`
+    bool stopping;        /// Guarded by `mutex`
+    bool pending;         /// Guarded by `mutex`
+    int pendingRequester; /// Guarded by `mutex`
+    bool pendingQuiet;    /// Guarded by `mutex`
+
+    std::atomic<bool> autoReload;
+    std::atomic<bool> resultReady; /// Lets the main thread skip the shared_ptr swap on ticks where nothing finished
+    std::shared_ptr<const ConfigurationLoad> result; /// Only accessed through std::atomic_load/store/exchange
+    int watchFD;     /// The inotify descriptor; only touched by the worker thread
+    bool watchFailed;
+    int wakeFD;      /// An eventfd the worker polls alongside `watchFD` so requests and stop() wake it immediately
+};
+
+/// The sections of the plug-in whose latency is tracked by PluginStats
+enum class StatSection
+{
+    AllowCTFCapture,
+    AllowFlagGrab,
+    Capture,
+    FlagGrabbed,
+    FlagDropped,
+    PlayerJoin,
+    PlayerPart,
+    PlayerSpawn,
+    WorldFinalized,
+    BZDBChange,
+    Tick,
+    OtherEvent,
+    CallbackCalcBonusPoints,
+    CallbackIsFairCapture,
+    CallbackListenOnCapture,
+    CallbackRemoveOnCapture,
+    CallbackGetAPI,
+    CallbackUnknown,
+    Count
+};
+
+/// The outcomes counted by PluginStats
+enum class StatCounter
+{
+    GrabAllowed,
+    GrabDeniedCooldown,
+    CaptureAllowed,
+    CaptureDeniedSelfCap,
+    CaptureDeniedUnfair,
+    CooldownWarningSent,
+    UnfairTeamWarningSent,
+    CooldownWarningDropped,
+    UnfairTeamWarningDropped,
+    UnfairCaptureNoticeDropped,
+    ListenerInvocations,
+    AsyncListenerQueued,
+    AsyncListenerDropped,
+    QueuedMessageDropped,
+    Count
+};
+
+/// A latency histogram with power-of-two buckets; bucket `i` holds samples in [2^i, 2^(i+1)) nanoseconds
+struct LatencyHistogram
+{
+    static const int BUCKETS = 40;
+
+    std::array<uint64_t, BUCKETS> buckets;
+    uint64_t samples;
+    uint64_t totalNs;
+    uint64_t maxNs;
+
+    void reset();
+    void record(uint64_t ns);
+    uint64_t percentile(double fraction) const;
+};
+
+/// The names StatSection values are reported and traced under
+const char* const STAT_SECTION_NAMES[(size_t)StatSection::Count] = {
+    "AllowCTFCapture", "AllowFlagGrab", "Capture", "FlagGrabbed", "FlagDropped", "PlayerJoin", "PlayerPart",
+    "PlayerSpawn", "WorldFinalized", "BZDBChange", "Tick", "OtherEvent", "calcBonusPoints", "isFairCapture",
+    "listenOnCapture", "removeOnCapture", "getAPIV1", "unknown callback",
+};
+
+/// Records spans into a ring buffer per thread while tracing is on, and writes a window of them out as a Chrome trace
+/// (https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU) that Perfetto and chrome://tracing
+/// can open. Each thread only ever writes to its own buffer, so recording a span takes no locks.
+class Tracer
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    Tracer();
+
+    /// The one check made on every traced scope; everything else only happens while tracing
+    static bool enabled()
+    {
+        return active.load(std::memory_order_relaxed);
+    }
+
+    /// The spans recorded in the last few seconds, copied out of every thread's buffer
+    struct Capture
+    {
+        struct Span
+        {
+            const char* name;
+            const char* category;
+            int64_t start;
+            int64_t duration;
+            size_t thread;
+        };
+
+        std::vector<Span> spans;
+        std::vector<const char*> threadNames;
+        int64_t since; /// Spans that ended before this are left out
+    };
+
+    void setEnabled(bool enable);
+    void nameThread(const char* name);
+    void releaseThread();
+    void record(const char* name, const char* category, Clock::time_point start, Clock::time_point end);
+    void capture(double seconds, Capture &out);
+    static bool write(const std::string &path, const Capture &capture, size_t &written);
+
+private:
+    /// Fields are atomics only so a dump running on another thread may read them while they're overwritten
+    struct Span
+    {
+        std::atomic<const char*> name;
+        std::atomic<const char*> category;
+        std::atomic<int64_t> start; /// Nanoseconds since `epoch`
+        std::atomic<int64_t> duration;
+    };
+
+    struct ThreadBuffer
+    {
+        ThreadBuffer() : spans(TRACE_BUFFER_EVENTS), head(0), name(NULL) {}
+
+        std::vector<Span> spans;
+        std::atomic<uint64_t> head; /// The number of spans ever recorded; the newest is at `head - 1`
+        std::atomic<const char*> name;
+    };
+
+    ThreadBuffer& buffer();
+
+    static std::atomic<bool> active;
+
+    Clock::time_point epoch;
+    std::mutex buffersLock;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers; /// Never shrinks, so the thread-local pointers stay valid
+    std::vector<ThreadBuffer*> idleBuffers; /// Buffers of threads that have exited, reused by the next new thread
+};
+
+/// Names the calling thread in traces for as long as it's in scope, then hands its span buffer back to the tracer. Every
+/// thread the plug-in starts holds one, so threads that come and go don't each leave a buffer behind.
+class TraceThread
+{
+public:
+    explicit TraceThread(const char* name);
+    ~TraceThread();
+};
+
+/// Traces its scope as a span when tracing is on; `name` and `category` must outlive the plug-in (string literals)
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char* _name, const char* _category = "ctfOverseer");
+    ~TraceSpan();
+
+private:
+    const char* name;
+    const char* category;
+    bool active;
+    Tracer::Clock::time_point start;
+};
+
+/// Writes /ctftrace dumps on a background thread so the main thread never waits on the disk; one dump runs at a time
+class TraceDumpWriter
+{
+public:
+    TraceDumpWriter();
+    ~TraceDumpWriter();
+
+    /// Copy the spans from the last `seconds` and start writing them to `path`; false if a dump is still being written
+    bool start(const std::string &path, double seconds, int requestedBy);
+
+    /// Tell the player who asked for a finished dump how it went; called from the main thread on every tick
+    void reportFinished();
+    void stop();
+
+private:
+    void run();
+
+    std::thread worker;
+    std::atomic<bool> finished;
+    Tracer::Capture capture;
+    std::string filePath;
+    double window;
+    int requester;
+    size_t written; /// Only read once `finished` is set
+    bool succeeded; /// Only read once `finished` is set
+};
+
+/// Spans are recorded by every thread of the plug-in into the same tracer
+static Tracer tracer;
+
+/// The calling thread's buffer in `tracer`, created on the thread's first span
+static thread_local void* threadTraceBuffer = NULL;
+static thread_local const char* threadTraceName = NULL; /// Given to the buffer once it's created
+
+/// Per-section latency histograms and outcome counters, dumped and reset with /ctfstats
+class PluginStats
+{
+public:
+    PluginStats();
+
+    void record(StatSection section, uint64_t ns);
+    void count(StatCounter counter, uint64_t amount = 1)
+    {
+        counters[(size_t)counter] += amount;
+    }
+
+    void called(StatSection section)
+    {
+        calls[(size_t)section]++;
+    }
+
+    bool shouldSample()
+    {
+        return (sampleTick++ & (LATENCY_SAMPLE_INTERVAL - 1)) == 0;
+    }
+
+    void reset();
+    void report(int playerID) const;
+
+private:
+    std::array<LatencyHistogram, (size_t)StatSection::Count> histograms;
+    std::array<uint64_t, (size_t)StatSection::Count> calls;
+    std::array<uint64_t, (size_t)StatCounter::Count> counters;
+    uint32_t sampleTick;
+    double since;
+};
+
+/// Counts a call into PluginStats and, for a sample of calls, records the time spent in its scope; `section` may be
+/// changed before the scope ends. While tracing, every call is also recorded as a span named after its section.
+class ScopedLatency
+{
+public:
+    ScopedLatency(PluginStats &_stats, StatSection _section) :
+        section(_section),
+        stats(_stats),
+        sampled(_stats.shouldSample()),
+        traced(Tracer::enabled())
+    {
+        if (sampled || traced)
+        {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~ScopedLatency();
+
+    StatSection section;
+
+private:
+    PluginStats &stats;
+    bool sampled;
+    bool traced;
+    std::chrono::steady_clock::time_point start;
+};
+
+/// Rate limits notices per player slot and notice class. Each bucket is stored as the single time it will next have a
+/// token to spare (the generic cell rate algorithm), which behaves exactly like a token bucket.
+class NoticeLimiter
+{
+public:
+    NoticeLimiter();
+
+    void configure(MessageClass kind, const NoticeLimit &limit);
+    bool allow(int playerID, MessageClass kind, double now);
+    void resetPlayer(int playerID);
+
+private:
+    struct Rate
+    {
+        double interval; /// Seconds per token
+        double tolerance; /// How far ahead of `now` a bucket's time may run, i.e. (burst - 1) * interval
+    };
+
+    std::array<Rate, NOTICE_CLASSES> rates;
+    std::array<double, MAX_PLAYER_SLOTS * NOTICE_CLASSES> nextToken; /// Indexed by [player slot][notice class]
+};
+
+/// Messages queued by the event handlers and sent in batches on bz_eTickEvent. Slots are reused so their text buffers
+/// keep their capacity between ticks. The queue holds at most OUTBOX_CAPACITY messages; once it's full the oldest notice
+/// is dropped to make room, and capture messages are only dropped when nothing but captures is queued.
+class OutboundMessageQueue
+{
+public:
+    OutboundMessageQueue();
+
+    /// A message that `continuesBroadcast` is another copy of the message queued just before it, sent to a different
+    /// player; the copies of a broadcast only count once against the budget.
+    std::string& enqueue(int recipient, MessageClass kind, bool continuesBroadcast = false);
+    size_t drain(size_t budget);
+    void dropRecipient(int playerID);
+
+    /// The number of messages dropped to stay within OUTBOX_CAPACITY since the last call
+    size_t takeDropped()
+    {
+        size_t count = dropped;
+        dropped = 0;
+
+        return count;
+    }
+
+    size_t size() const
+    {
+        return tail - head;
+    }
+
+    bool empty() const
+    {
+        return head == tail;
+    }
+
+private:
+    struct Message
+    {
+        int recipient;
+        MessageClass kind;
+        bool continuesBroadcast;
+        std::string text;
+    };
+
+    Message& slot(size_t index)
+    {
+        return slots[index & (slots.size() - 1)];
+    }
+
+    size_t* pendingNotice(int recipient, MessageClass kind);
+    void evictOldest();
+
+    std::vector<Message> slots; /// A ring buffer whose size is always a power of two
+    size_t head; /// The next message to send
+    size_t tail; /// One past the last queued message
+    size_t dropped; /// Messages dropped since the last takeDropped()
+
+    /// Where each recipient's unsent notice of each class is queued, indexed by [player slot, then BZ_ALLUSERS][notice
+    /// class]. An entry is stale once it falls outside [head, tail) or its message was dropped by dropRecipient().
+    std::array<size_t, (MAX_PLAYER_SLOTS + 1) * NOTICE_CLASSES> noticeIndex;
+};
+
+/// A capture as it's handed to listeners. V2 listeners get `event`; V1 listeners keep the meaning V1 had before
+/// CaptureEventV2 existed, which the last two fields preserve.
+struct CaptureDispatch
+{
+    CaptureEventV2 event;
+    bool notifyV1;           /// V1 listeners are never called for self-captures disallowed by `_disallowSelfCap`
+    bool unfairCapsDisabled; /// V1's `wasDisallowed` argument: whether `_disallowUnfairCap` is set
+};
+
+/// A capture listener that runs on an AsyncListenerPool worker. The callbacks are only touched by the worker while it
+/// holds its invoke lock, so the main thread can clear them on removal and be sure they never run again.
+struct AsyncCaptureListener
+{
+    int handle;
+    OnCaptureEventCallbackV1 v1;
+    OnCaptureEventCallbackV2 v2;
+
+    std::atomic<bool> removed{false};
+    std::atomic<uint64_t> pending{0};   /// Events queued for this listener and not delivered yet
+    std::atomic<uint64_t> delivered{0};
+    std::atomic<uint64_t> dropped{0};   /// Events that didn't fit in the worker's queue
+};
+
+/// A bounded multi-producer, single-consumer queue of capture events (Vyukov's array queue). Every cell carries a
+/// sequence number, so producers only contend on a single counter and the consumer never takes a lock.
+class CaptureEventQueue
+{
+public:
+    struct Delivery
+    {
+        std::shared_ptr<AsyncCaptureListener> listener;
+        CaptureDispatch capture;
+    };
+
+    explicit CaptureEventQueue(size_t capacity);
+
+    bool push(const std::shared_ptr<AsyncCaptureListener> &listener, const CaptureDispatch &capture);
+    bool pop(Delivery &delivery);
+    size_t size() const;
+
+    size_t capacity() const
+    {
+        return cells.size();
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        Delivery delivery;
+    };
+
+    std::vector<Cell> cells; /// A power of two in size
+    size_t mask;
+    std::atomic<size_t> enqueuePos;
+    char padding[64];                /// Keeps the producers' counter off the consumer's cache line
+    std::atomic<size_t> dequeuePos;  /// Only written by the consumer
+};
+
+/// Worker threads that deliver capture events to async listeners. Each listener is pinned to one worker, so the events it
+/// receives stay in order, and the main thread never waits on a listener: a full queue drops the event and counts it.
+class AsyncListenerPool
+{
+public:
+    AsyncListenerPool();
+    ~AsyncListenerPool();
+
+    /// Takes effect the next time the pool is started; a running pool keeps its workers and queues
+    void configure(int threads, int queueSize);
+    bool isRunning() const;
+    void start();
+    void stop();
+
+    bool enqueue(const std::shared_ptr<AsyncCaptureListener> &listener, const CaptureDispatch &capture);
+    void retire(AsyncCaptureListener &listener);
+    void report(int playerID, const std::vector<std::shared_ptr<AsyncCaptureListener>> &listeners) const;
+    void resetStats(const std::vector<std::shared_ptr<AsyncCaptureListener>> &listeners);
+
+private:
+    struct Worker
+    {
+        explicit Worker(size_t capacity) : queue(capacity), sleeping(false), highWater(0) {}
+
+        CaptureEventQueue queue;
+        std::thread thread;
+        std::mutex invokeLock; /// Held while a callback runs
+        std::mutex wakeLock;
+        std::condition_variable wake;
+        std::atomic<bool> sleeping;
+        std::atomic<size_t> highWater; /// The deepest the queue has been; a sign of a listener that can't keep up
+    };
+
+    void run(Worker &worker);
+    Worker& workerFor(const AsyncCaptureListener &listener) const;
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<bool> running;
+    int threadCount;
+    size_t queueCapacity;
+};
+
+/// Capture listeners stored contiguously; removal during dispatch is deferred until the outermost dispatch finishes.
+/// Async listeners are kept in the same list and handle space, but their events are handed to an AsyncListenerPool.
+class CaptureListenerRegistry
+{
+public:
+    CaptureListenerRegistry();
+
+    int add(const OnCaptureEventCallbackV1 &callback, bool async = false);
+    int add(const OnCaptureEventCallbackV2 &callback, bool async = false);
+    bool remove(int handle);
+    size_t dispatch(const CaptureDispatch &capture, size_t &queued, size_t &dropped);
+    void configureAsync(int threads, int queueSize);
+    void reportAsync(int playerID) const;
+    void resetAsyncStats();
+    void clear();
+
+private:
+    std::vector<std::shared_ptr<AsyncCaptureListener>> asyncListeners() const;
+
+    struct Listener
+    {
+        int handle;
+        bool removed;
+        bool isV1; /// Registered with a V1 callback, sync or async
+        OnCaptureEventCallbackV1 v1;
+        OnCaptureEventCallbackV2 v2;
+        std::shared_ptr<AsyncCaptureListener> async; /// Set instead of `v1` and `v2` for async listeners
+    };
+
+    int add(Listener &&listener);
+    void compact();
+
+    std::vector<Listener> listeners; /// Sorted by handle since handles only ever increase
+    std::vector<Listener> pending; /// Listeners added during a dispatch; appended afterwards so `listeners` never reallocates mid-call
+    AsyncListenerPool asyncPool;   /// Started when the first async listener is added
+    int nextHandle;
+    int dispatchDepth;
+    bool needsCompaction;
+};
+
+/// Writes log lines to a local file from a background thread; the event handlers only copy into a lock-free ring buffer
+class AsyncLogSink
+{
+public:
+    AsyncLogSink();
+    ~AsyncLogSink();
+
+    bool open(const std::string &path);
+    void close();
+    bool isOpen() const;
+    const std::string& path() const;
+
+    void push(double time, int level, const char* message);
+    uint64_t dropped() const;
+
+private:
+    struct Entry
+    {
+        double time;
+        int level;
+        char message[244];
+    };
+
+    static const size_t CAPACITY = 1024; /// Must be a power of two
+
+    void run();
+
+    std::vector<Entry> ring;
+    std::atomic<size_t> head; /// The next slot the producer (the main bzfs thread) writes to
+    std::atomic<size_t> tail; /// The next slot the background writer reads from
+    std::atomic<uint64_t> droppedEntries;
+    std::atomic<double> lastDropTime; /// The time of the most recently dropped line, for the line reporting drops
+    std::atomic<bool> running;
+    std::thread writer;
+    std::string filePath;
+    FILE* file;
+};
+
+/// Checks the log level before any formatting happens so disabled diagnostics cost a single comparison
+class Logger
+{
+public:
+    Logger();
+
+    bool isEnabled(int level) const
+    {
+        return level <= bz_getDebugLevel() || (sink.isOpen() && level <= sinkLevel);
+    }
+
+#ifdef __GNUC__
+    __attribute__((format(printf, 3, 4)))
+#endif
+    void log(int level, const char* fmt, ...);
+    void setFileSink(const std::string &path, int level);
+    void close();
+
+private:
+    AsyncLogSink sink;
+    int sinkLevel;
+};
+
+/// Appends capture records to memory-mapped, preallocated segment files so recording an event never makes a system call
+class CaptureLogWriter
+{
+public:
+    explicit CaptureLogWriter(Logger &_logger);
+    ~CaptureLogWriter();
+
+    bool open(const std::string &directory, uint32_t recordsPerSegment);
+    void close();
+    bool isOpen() const;
+    const std::string& directory() const;
+
+    void append(const CaptureLogRecord &record);
+    uint64_t written() const;
+
+private:
+    bool openSegment();
+    void closeSegment();
+
+    Logger &logger;
+    std::string logDirectory;
+    uint32_t segmentCapacity;
+    uint32_t segmentSequence;
+    int fd;                    /// The current segment file, kept open so it can be trimmed when closed
+    CaptureLogHeader* header;  /// The start of the current segment's mapping, or NULL if no segment is open
+    CaptureLogRecord* records;
+    size_t mappingSize;
+    uint64_t recordCount;      /// Records in the current segment
+    uint64_t totalWritten;
+};
+
+/// Publishes scoreboard snapshots to a POSIX shared memory segment that local processes can read without involving bzfs
+class ScoreboardPublisher
+{
+public:
+    explicit ScoreboardPublisher(Logger &_logger);
+    ~ScoreboardPublisher();
+
+    bool open(const std::string &name);
+    void close();
+    bool isOpen() const;
+    const std::string& name() const;
+
+    void publish(const ScoreboardSnapshot &snapshot);
+
+private:
+    Logger &logger;
+    std::string segmentName;
+    ScoreboardSegment* segment; /// NULL unless a segment is mapped
+};
+
+/// The per-player statistics kept for the ladder
+enum class PlayerStat
+{
+    Captures,       /// Fair captures of an enemy team flag
+    UnfairCaptures, /// Captures of an enemy team flag while teams were unfair
+    SelfCaptures,
+    DeniedCaptures, /// Captures disallowed by `_disallowSelfCap` or `_disallowUnfairCap`
+    DeniedGrabs,    /// Team flag grabs denied during a `_delayTeamFlagGrab` cooldown
+    BonusPoints,    /// Points won with fair captures
+    PenaltyPoints,  /// Points lost to self and unfair captures
+    Count
+};
+
+const size_t PLAYER_STATS = (size_t)PlayerStat::Count;
+
+/// Indexed by PlayerStat; also the column names in the store file and the names accepted by /ctftop
+const char* const PLAYER_STAT_NAMES[PLAYER_STATS] = {
+    "caps",
+    "unfair_caps",
+    "self_caps",
+    "denied_caps",
+    "denied_grabs",
+    "bonus",
+    "penalty",
+};
+
+struct PlayerStatRecord
+{
+    std::string callsign;
+    std::array<int64_t, PLAYER_STATS> values;
+};
+
+/// Per-player statistics persisted to a local file. The event handlers only add to counters kept as one column per
+/// statistic and indexed by player ID. Every flush interval the slots that changed are handed off as one batch to a
+/// background thread, which merges it into the totals and appends one line per changed callsign to the file; the file
+/// is rewritten from the totals once most of its lines are superseded, so the main thread never touches the disk.
+class PlayerStatsStore
+{
+public:
+    explicit PlayerStatsStore(Logger &_logger);
+    ~PlayerStatsStore();
+
+    /// Opening and closing don't wait for the disk; a file that was closed is finished in the background
+    void open(const std::string &path);
+    void close();
+    /// Close the file and wait until everything has been written
+    void stop();
+    bool isOpen() const;
+    const std::string& path() const;
+    void setFlushInterval(double seconds);
+
+    /// Callsigns are tracked even while the store is closed so it can be opened at any time
+    void setPlayer(int playerID, const char* callsign);
+    void removePlayer(int playerID);
+
+    void add(int playerID, PlayerStat stat, int amount = 1)
+    {
+        if (!writer || (unsigned)playerID >= (unsigned)MAX_PLAYER_SLOTS || callsigns[playerID].empty())
+        {
+            return;
+        }
+
+        columns[(size_t)stat][playerID] += amount;
+        dirty[playerID] = true;
+    }
+
+    /// Hand off the changes since the last flush once the flush interval has passed
+    void flush(double now);
+
+    /// Totals including changes that haven't been written yet; false while the file is still being loaded. The record's
+    /// callsign is left empty when the player has no stats.
+    bool lookup(const std::string &callsign, PlayerStatRecord &record);
+    bool top(PlayerStat stat, size_t count, std::vector<PlayerStatRecord> &records);
+
+private:
+    typedef std::map<std::string, PlayerStatRecord> RecordMap; /// Keyed by lowercased callsign
+    typedef std::set<std::pair<int64_t, std::string>, std::greater<std::pair<int64_t, std::string>>> Ranking; /// Value and key, highest first
+
+    /// A file and the thread writing it, which outlives the file being closed until everything has been written
+    struct Writer
+    {
+        explicit Writer(const std::string &_path);
+
+        void run();
+        void merge(const PlayerStatRecord &change);
+        bool load(RecordMap &records, size_t &lines);
+        bool save(const RecordMap &records);
+        bool append(const RecordMap &changes);
+
+        const std::string path;
+        std::thread thread;
+        std::vector<std::shared_ptr<Writer>> previous; /// Closed writers that may still be writing; waited for before the file is read
+
+        std::mutex mutex;
+        std::condition_variable wake;
+        bool stopping;                              /// Guarded by `mutex`
+        bool loaded;                                /// Guarded by `mutex`
+        bool finished;                              /// Guarded by `mutex`; the thread won't touch the file again
+        bool lost;                                  /// Guarded by `mutex`; the last changes couldn't be written before finishing
+        std::vector<PlayerStatRecord> pending;      /// Guarded by `mutex`; handed off but not merged yet
+        RecordMap totals;                           /// Guarded by `mutex`
+        std::array<Ranking, PLAYER_STATS> rankings; /// Guarded by `mutex`; every callsign in `totals`, once per statistic
+        std::atomic<uint64_t> failedWrites;
+    };
+
+    void stage(int playerID);
+    void handOff();
+    bool collect(const std::string* key, PlayerStat stat, size_t count, RecordMap &records);
+    void reap(bool wait);
+
+    Logger &logger;
+
+    // Only touched by the main thread
+    std::array<std::array<int32_t, MAX_PLAYER_SLOTS>, PLAYER_STATS> columns; /// [stat][player ID]; changes since the slot was last staged
+    std::array<bool, MAX_PLAYER_SLOTS> dirty;
+    std::array<std::string, MAX_PLAYER_SLOTS> callsigns; /// Empty for slots nobody is using
+    std::vector<PlayerStatRecord> staged; /// Changes waiting for the next hand-off, e.g. from players who left
+    double flushInterval;
+    double nextFlush;
+    uint64_t reportedFailures;
+    std::string filePath;
+    std::shared_ptr<Writer> writer; /// Empty while the store is closed
+    std::vector<std::shared_ptr<Writer>> retired; /// Closed but still writing, or finished and waiting to be joined
+};
+
+class CTFOverseer : public bz_Plugin, public bz_CustomSlashCommandHandler
+{
+public:
+    const char* Name();
+    void Init(const char* config);
+    void Cleanup();
+    void Event(bz_EventData* eventData);
+    int GeneralCallback(const char* name, void* data);
+    bool SlashCommand(int playerID, bz_ApiString command, bz_ApiString message, bz_APIStringList *params);
+
+private:
+    void loadConfigurationFile();
+    void applyConfiguration(const std::shared_ptr<const Configuration> &config);
+    void applyPendingReload();
+    bool admitNotice(int playerID, MessageClass kind);
+    void publishScoreboard();
+    void safeSendMessage(MessageID message, int recipient, MessageClass kind, const PlaceholderValues &values);
+    void setPointsPlaceholders(int points);
+    void setNumberPlaceholder(Placeholder placeholder, int value);
+    LocaleID localeOf(int playerID) const;
+    LocaleID joinLocale(const bz_BasePlayerRecord* record) const;
+    void setPlayerLocale(int playerID, LocaleID locale);
+    void remapPlayerLocales(const MessageCatalog &previous);
+    int capturePoints(bz_eTeamType capping, bz_eTeamType capped, bool isSelfCap, bool isFair);
+
+    bool isFairCapture(bz_eTeamType capping, bz_eTeamType capped);
+    int calcCapturePoints(bz_eTeamType capping, bz_eTeamType capped);
+    void syncRoster();
+    void refreshBZDBSettings();
+    void rebuildBonusMatrix();
+    void refreshDecayedBonusMatrix();
+    int scoringTeamSize(int team, double now) const;
+    void rebuildFlagStates();
+    double flagCooldownRemaining(bz_eTeamType team, double now) const;
+    void initFunctionTable();
+    void loadStateSnapshot();
+    void applyStateSnapshot();
+    void recordCapture(CaptureLogKind kind, int playerID, bz_eTeamType capping, bz_eTeamType capped, int points, uint8_t flags);
+
+    static int apiCalcBonusPoints(void* context, int teamCapping, int teamCapped);
+    static int apiIsFairCapture(void* context, int teamCapping, int teamCapped);
+    static int apiGetTeamSizes(void* context, int* sizes, int count);
+    static int apiGetBonusMatrix(void* context, int* matrix, int teams);
+    static int apiGetFlagCooldowns(void* context, double* remaining, int count);
+
+    std::shared_ptr<const Configuration> settings; /// Never modified once built; replaced as a whole on reload
+    ConfigReloader reloader;
+    TraceDumpWriter traceDump;
+    Logger logger;
+
+    PlaceholderValues placeholders; /// Reused between captures so rendering doesn't allocate once warmed up
+    OutboundMessageQueue outbox;    /// Messages waiting to be sent on the next tick
+    NoticeLimiter notices;          /// Every notice to a single player passes through here before it's queued
+
+    std::array<LocaleID, MAX_PLAYER_SLOTS> playerLocale; /// Picked when a player joins; NO_LOCALE for empty slots
+    std::array<std::vector<int>, MAX_LOCALES> localePlayers; /// The players using each locale, in no particular order
+    std::map<std::string, std::string> localePreferences; /// Locales picked with /ctflang, by BZID or callsign
+    std::string localizedText;                           /// Reused when a public message has to be rendered per locale
+
+    StateStore state;
+    TeamFlagTracker flags; /// Derived from `state` and the grab delay; rebuilt whenever either changes as a whole
+    std::vector<uint8_t> pendingSnapshot; /// A loaded snapshot waiting for the world to be finalized
+    BZDBSettings bzdb;
+    TeamRoster roster;
+    DecayedTeamSizes decayedSizes; /// Only kept up to date while `_teamSizeDecayWindow` is positive
+    std::array<int, TEAM_SLOTS> scoringSize; /// The team sizes `bonusMatrix` was built from
+    TeamMatrix bonusMatrix; /// The points a capture is currently worth for every [capping][capped] team pair
+
+    CaptureListenerRegistry captureListeners;
+    CaptureLogWriter captureLog{logger};
+    PlayerStatsStore playerStats{logger};
+    ScoreboardPublisher scoreboardOut{logger};
+    ScoreboardSnapshot scoreboard; /// The capture counters live here; everything else is filled in when publishing
+    bool scoreboardDirty;          /// Set whenever something on the scoreboard changed, and published on the next tick
+    PluginStats stats;
+    CTFOverseerAPIV1 functionTable;
+
+    const char* bzdb_delayTeamFlagGrab = "_delayTeamFlagGrab";
+    const char* bzdb_disallowSelfCap = "_disallowSelfCap";
+    const char* bzdb_disallowUnfairCap = "_disallowUnfairCap";
+    const char* bzdb_maxCapBonus = "_maxCapBonus";
+    const char* bzdb_warnUnfairTeams = "_warnUnfairTeams";
+    const char* bzdb_teamSizeDecayWindow = "_teamSizeDecayWindow";
+
+    bz_ApiString configFile;
+};
+
+BZ_PLUGIN(CTFOverseer)
+
+AsyncLogSink::AsyncLogSink() :
+    head(0),
+    tail(0),
+    droppedEntries(0),
+    lastDropTime(0),
+    running(false),
+    file(NULL)
+{
+}
+
+AsyncLogSink::~AsyncLogSink()
+{
+    close();
+}
+
+bool AsyncLogSink::open(const std::string &path)
+{
+    close();
+
+    file = fopen(path.c_str(), "a");
+
+    if (!file)
+    {
+        return false;
+    }
+
+    ring.resize(CAPACITY);
+    head = 0;
+    tail = 0;
+    filePath = path;
+    running = true;
+    writer = std::thread(&AsyncLogSink::run, this);
+
+    return true;
+}
+
+void AsyncLogSink::close()
+{
+    if (!running)
+    {
+        return;
+    }
+
+    running = false;
+    writer.join();
+
+    fclose(file);
+    file = NULL;
+    filePath.clear();
+}
+
+bool AsyncLogSink::isOpen() const
+{
+    return running.load(std::memory_order_relaxed);
+}
+
+const std::string& AsyncLogSink::path() const
+{
+    return filePath;
+}
+
+void AsyncLogSink::push(double time, int level, const char* message)
+{
+    size_t currentHead = head.load(std::memory_order_relaxed);
+
+    // Never block the event handlers; if the writer has fallen behind, drop the line and keep count instead
+    if (currentHead - tail.load(std::memory_order_acquire) >= CAPACITY)
+    {
+        lastDropTime.store(time, std::memory_order_relaxed);
+        droppedEntries.fetch_add(1, std::memory_order_release);
+        return;
+    }
+
+    Entry &entry = ring[currentHead & (CAPACITY - 1)];
+    entry.time = time;
+    entry.level = level;
+    snprintf(entry.message, sizeof(entry.message), "%s", message);
+
+    head.store(currentHead + 1, std::memory_order_release);
+}
+
+uint64_t AsyncLogSink::dropped() const
+{
+    return droppedEntries.load(std::memory_order_relaxed);
+}
+
+void AsyncLogSink::run()
+{
+    TraceThread traceThread("debug log writer");
+    uint64_t reportedDrops = 0;
+
+    while (true)
+    {
+        // Read `running` before draining so nothing pushed before close() is left behind
+        bool keepRunning = running.load(std::memory_order_acquire);
+        size_t currentTail = tail.load(std::memory_order_relaxed);
+        size_t currentHead = head.load(std::memory_order_acquire);
+
+        for (; currentTail != currentHead; currentTail++)
+        {
+            const Entry &entry = ring[currentTail & (CAPACITY - 1)];
+            fprintf(file, "%.3f\t%d\t%s\n", entry.time, entry.level, entry.message);
+        }
+
+        tail.store(currentTail, std::memory_order_release);
+
+        uint64_t drops = dropped();
+
+        if (drops != reportedDrops)
+        {
+            fprintf(file, "%.3f\t0\tWARNING :: CTF Overseer :: %llu log lines were dropped\n", lastDropTime.load(std::memory_order_relaxed),
+                (unsigned long long)(drops - reportedDrops));
+            reportedDrops = drops;
+        }
+
+        fflush(file);
+
+        if (!keepRunning)
+        {
+            break;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+}
+
+Logger::Logger() :
+    sinkLevel(VERBOSE_DEBUG_LEVEL)
+{
+}
+
+void Logger::log(int level, const char* fmt, ...)
+{
+    if (!isEnabled(level))
+    {
+        return;
+    }
+
+    char buffer[512];
+
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buffer, sizeof(buffer), fmt, args);
+    va_end(args);
+
+    if (level <= bz_getDebugLevel())
+    {
+        bz_debugMessage(level, buffer);
+    }
+
+    if (sink.isOpen() && level <= sinkLevel)
+    {
+        sink.push(bz_getCurrentTime(), level, buffer);
+    }
+}
+
+void Logger::setFileSink(const std::string &path, int level)
+{
+    sinkLevel = level;
+
+    if (path == sink.path())
+    {
+        return;
+    }
+
+    sink.close();
+
+    if (!path.empty() && !sink.open(path))
+    {
+        log(0, "ERROR :: CTF Overseer :: Could not open debug log file for writing: %s", path.c_str());
+    }
+}
+
+void Logger::close()
+{
+    sink.close();
+}
+
+CaptureLogWriter::CaptureLogWriter(Logger &_logger) :
+    logger(_logger),
+    segmentCapacity(DEFAULT_CAPTURE_LOG_SEGMENT_RECORDS),
+    segmentSequence(0),
+    fd(-1),
+    header(NULL),
+    records(NULL),
+    mappingSize(0),
+    recordCount(0),
+    totalWritten(0)
+{
+}
+
+CaptureLogWriter::~CaptureLogWriter()
+{
+    close();
+}
+
+bool CaptureLogWriter::open(const std::string &directory, uint32_t recordsPerSegment)
+{
+    close();
+
+    logDirectory = directory;
+    segmentCapacity = std::max<uint32_t>(1, recordsPerSegment);
+    segmentSequence = 0;
+
+    if (!openSegment())
+    {
+        logDirectory.clear();
+        return false;
+    }
+
+    return true;
+}
+
+void CaptureLogWriter::close()
+{
+    closeSegment();
+    logDirectory.clear();
+}
+
+bool CaptureLogWriter::isOpen() const
+{
+    return header != NULL;
+}
+
+const std::string& CaptureLogWriter::directory() const
+{
+    return logDirectory;
+}
+
+void CaptureLogWriter::append(const CaptureLogRecord &record)
+{
+    if (!header)
+    {
+        return;
+    }
+
+    // Only rolling over to a new segment touches the file system; every other append is a copy into the mapping
+    if (recordCount == segmentCapacity)
+    {
+        closeSegment();
+
+        if (!openSegment())
+        {
+            logger.log(0, "ERROR :: CTF Overseer :: Could not start a new capture log segment in %s, capture logging stopped", logDirectory.c_str());
+            return;
+        }
+    }
+
+    records[recordCount] = record;
+    recordCount++;
+    totalWritten++;
+
+    // Publish the count only once the record is complete so a reader of a live segment never sees a partial record
+    std::atomic_thread_fence(std::memory_order_release);
+    header->recordCount = recordCount;
+}
+
+uint64_t CaptureLogWriter::written() const
+{
+    return totalWritten;
+}
+
+#ifndef _WIN32
+bool CaptureLogWriter::openSegment()
+{
+    time_t now = time(NULL);
+
+    char path[4096];
+
+    // Never reuse an existing segment, e.g. when the plug-in is reloaded within the same second
+    do
+    {
+        snprintf(path, sizeof(path), "%s/captures-%lld-%u%s", logDirectory.c_str(), (long long)now, segmentSequence++, CAPTURE_LOG_EXTENSION);
+        fd = ::open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+    }
+    while (fd < 0 && errno == EEXIST);
+
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    mappingSize = sizeof(CaptureLogHeader) + (size_t)segmentCapacity * sizeof(CaptureLogRecord);
+
+    // Reserve the blocks up front so a full disk fails here instead of as a SIGBUS while writing through the mapping
+    void* mapping = MAP_FAILED;
+
+    if (posix_fallocate(fd, 0, mappingSize) == 0)
+    {
+        mapping = mmap(NULL, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+
+    if (mapping == MAP_FAILED)
+    {
+        ::close(fd);
+        unlink(path);
+
+        fd = -1;
+        mappingSize = 0;
+
+        return false;
+    }
+
+    header = (CaptureLogHeader*)mapping;
+    records = (CaptureLogRecord*)(header + 1);
+    recordCount = 0;
+
+    memset(header, 0, sizeof(CaptureLogHeader));
+    header->magic = CAPTURE_LOG_MAGIC;
+    header->version = CAPTURE_LOG_VERSION;
+    header->recordSize = sizeof(CaptureLogRecord);
+    header->capacity = segmentCapacity;
+    header->createdWallTime = now;
+    header->createdServerTime = bz_getCurrentTime();
+
+    return true;
+}
+
+void CaptureLogWriter::closeSegment()
+{
+    if (!header)
+    {
+        return;
+    }
+
+    munmap(header, mappingSize);
+
+    // Give back the space of the slots that were never used
+    if (ftruncate(fd, sizeof(CaptureLogHeader) + recordCount * sizeof(CaptureLogRecord)) != 0)
+    {
+        logger.log(2, "WARNING :: CTF Overseer :: Could not trim capture log segment in %s", logDirectory.c_str());
+    }
+
+    ::close(fd);
+
+    fd = -1;
+    header = NULL;
+    records = NULL;
+    mappingSize = 0;
+    recordCount = 0;
+}
+#else
+bool CaptureLogWriter::openSegment()
+{
+    logger.log(0, "ERROR :: CTF Overseer :: The capture log is not supported on this platform");
+    return false;
+}
+
+void CaptureLogWriter::closeSegment()
+{
+}
+#endif
+
+ScoreboardPublisher::ScoreboardPublisher(Logger &_logger) :
+    logger(_logger),
+    segment(NULL)
+{
+}
+
+ScoreboardPublisher::~ScoreboardPublisher()
+{
+    close();
+}
+
+bool ScoreboardPublisher::isOpen() const
+{
+    return segment != NULL;
+}
+
+const std::string& ScoreboardPublisher::name() const
+{
+    return segmentName;
+}
+
+void ScoreboardPublisher::publish(const ScoreboardSnapshot &snapshot)
+{
+    if (segment)
+    {
+        writeScoreboard(segment, snapshot);
+    }
+}
+
+#ifndef _WIN32
+bool ScoreboardPublisher::open(const std::string &name)
+{
+    close();
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    void* mapping = MAP_FAILED;
+
+    if (ftruncate(fd, sizeof(ScoreboardSegment)) == 0)
+    {
+        mapping = mmap(NULL, sizeof(ScoreboardSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+
+    ::close(fd);
+
+    if (mapping == MAP_FAILED)
+    {
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    // A segment left behind by a crashed server is simply taken over. Readers treat a zero sequence as nothing
+    // published, so it's reset before the snapshot is cleared.
+    segment = (ScoreboardSegment*)mapping;
+    segment->sequence.store(0, std::memory_order_release);
+    memset((void*)&segment->snapshot, 0, sizeof(ScoreboardSnapshot));
+
+    segment->magic = SCOREBOARD_MAGIC;
+    segment->version = SCOREBOARD_VERSION;
+    segment->size = sizeof(ScoreboardSegment);
+    segment->reserved = 0;
+
+    segmentName = name;
+
+    return true;
+}
+
+void ScoreboardPublisher::close()
+{
+    if (!segment)
+    {
+        return;
+    }
+
+    munmap((void*)segment, sizeof(ScoreboardSegment));
+    shm_unlink(segmentName.c_str());
+
+    segment = NULL;
+    segmentName.clear();
+}
+#else
+bool ScoreboardPublisher::open(const std::string &/*name*/)
+{
+    logger.log(0, "ERROR :: CTF Overseer :: The shared memory scoreboard is not supported on this platform");
+    return false;
+}
+
+void ScoreboardPublisher::close()
+{
+}
+#endif
+
+/// Strip surrounding quotes from a configuration value. bz_trim() can't be used off the main thread.
+static std::string stripQuotes(const std::string &value)
+{
+    size_t start = value.find_first_not_of('"');
+
+    if (start == std::string::npos)
+    {
+        return "";
+    }
+
+    return value.substr(start, value.find_last_not_of('"') - start + 1);
+}
+
+static std::string lowercase(std::string value)
+{
+    std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c) { return (char)tolower(c); });
+
+    return value;
+}
+
+/// The key a player's /ctflang choice is remembered by: their BZID when they're registered, otherwise their callsign
+static std::string localePreferenceKey(const bz_BasePlayerRecord* record)
+{
+    if (!record->bzID.empty())
+    {
+        return std::string("bzid:") + record->bzID.c_str();
+    }
+
+    return "callsign:" + lowercase(record->callsign.c_str());
+}
+
+/// Join the problems found in a configuration file into a single line for the log and for /reload
+static std::string joinProblems(const std::vector<std::string> &problems)
+{
+    std::string joined;
+
+    for (const std::string &problem : problems)
+    {
+        joined += joined.empty() ? problem : "; " + problem;
+    }
+
+    return joined;
+}
+
+/// Read an optional integer setting, leaving `value` untouched when it isn't set
+static bool readIntSetting(PluginConfig &cfg, const char* key, long minimum, int &value, std::string &error)
+{
+    std::string raw = cfg.item(CONFIG_SECTION, key);
+
+    if (raw.empty())
+    {
+        return true;
+    }
+
+    char* end = NULL;
+    long parsed = strtol(raw.c_str(), &end, 10);
+
+    if (*end != '\0' || parsed < minimum || parsed > INT_MAX)
+    {
+        error = std::string("invalid value for ") + key + ": " + raw;
+        return false;
+    }
+
+    value = (int)parsed;
+
+    return true;
+}
+
+static bool readDoubleSetting(PluginConfig &cfg, const char* key, double minimum, double &value, std::string &error)
+{
+    std::string raw = cfg.item(CONFIG_SECTION, key);
+
+    if (raw.empty())
+    {
+        return true;
+    }
+
+    char* end = NULL;
+    double parsed = strtod(raw.c_str(), &end);
+
+    if (*end != '\0' || !(parsed >= minimum))
+    {
+        error = std::string("invalid value for ") + key + ": " + raw;
+        return false;
+    }
+
+    value = parsed;
+
+    return true;
+}
+
+static bool readBoolSetting(PluginConfig &cfg, const char* key, bool &value, std::string &error)
+{
+    std::string raw = lowercase(cfg.item(CONFIG_SECTION, key));
+
+    if (raw.empty())
+    {
+        return true;
+    }
+
+    if (raw == "true" || raw == "yes" || raw == "1")
+    {
+        value = true;
+    }
+    else if (raw == "false" || raw == "no" || raw == "0")
+    {
+        value = false;
+    }
+    else
+    {
+        error = std::string("invalid value for ") + key + ": " + raw;
+        return false;
+    }
+
+    return true;
+}
+
+/// Read the messages set in a section of the configuration file into one of a catalog's locales. Unknown keys are added
+/// to `problems` and skipped.
+static void readMessages(PluginConfig &cfg, const std::string &section, MessageCatalog &catalog, LocaleID locale, std::vector<std::string> &problems)
+{
+    for (const auto &item : cfg.getSectionItems(section))
+    {
+        std::string key = lowercase(item.first);
+        size_t message = 0;
+
+        while (message < MESSAGE_COUNT && key != MESSAGE_DEFINITIONS[message].key)
+        {
+            message++;
+        }
+
+        if (message == MESSAGE_COUNT)
+        {
+            // The plug-in's own section holds every other setting as well
+            if (locale == DEFAULT_LOCALE)
+            {
+                continue;
+            }
+
+            problems.push_back("unknown message in [" + section + "]: " + item.first);
+            continue;
+        }
+
+        catalog.set(locale, (MessageID)message, stripQuotes(item.second));
+    }
+}
+
+/// Check a configuration file against the rules PluginConfig parses it by, adding every line it would reject to
+/// `problems`, and return whether the file could be read at all. PluginConfig reports those lines and missing files
+/// through the bzfs debug log, which may only be written to from the main thread, so files with either problem are never
+/// handed to it on the reload thread.
+static bool checkConfigurationSyntax(const std::string &path, std::vector<std::string> &problems)
+{
+    std::ifstream file(path.c_str());
+
+    if (!file)
+    {
+        problems.push_back("the file could not be opened");
+        return false;
+    }
+
+    const char* whitespace = " \t\r";
+    std::string line;
+    size_t lineNumber = 0;
+
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+
+        size_t start = line.find_first_not_of(whitespace);
+
+        if (start == std::string::npos || line[start] == '#')
+        {
+            continue;
+        }
+
+        bool malformed = (line[start] == '[') ? line[line.find_last_not_of(whitespace)] != ']' : line.find('=', start) == std::string::npos;
+
+        if (malformed)
+        {
+            problems.push_back("line " + std::to_string(lineNumber) + " is malformed: " + line.substr(start));
+        }
+    }
+
+    return true;
+}
+
+/// Build a complete Configuration from a file. A strict build returns NULL when anything in the file is wrong; otherwise
+/// every bad line, setting or section is skipped, leaving its default in place. Either way `error` lists every problem.
+/// This doesn't touch any plug-in or bzfs state so a strict build is safe to call from the reload thread.
+static std::shared_ptr<const Configuration> buildConfiguration(const std::string &path, bool strict, std::string &error)
+{
+    TraceSpan span("buildConfiguration", "config");
+
+    std::vector<std::string> problems;
+    PluginConfig plgCfg;
+
+    if (checkConfigurationSyntax(path, problems) && (problems.empty() || !strict))
+    {
+        plgCfg.read(path);
+    }
+
+    if (plgCfg.errors && problems.empty())
+    {
+        problems.push_back("the file could not be parsed");
+    }
+
+    if (strict && !problems.empty())
+    {
+        error = joinProblems(problems);
+        return nullptr;
+    }
+
+    std::shared_ptr<Configuration> config = std::make_shared<Configuration>();
+
+    std::string defaultLocale = lowercase(stripQuotes(plgCfg.item(CONFIG_SECTION, "default_locale")));
+    config->Messages = MessageCatalog(defaultLocale.empty() ? DEFAULT_LOCALE_NAME : defaultLocale);
+
+    readMessages(plgCfg, CONFIG_SECTION, config->Messages, DEFAULT_LOCALE, problems);
+
+    // Every `[ctfOverseer.<locale>]` section translates the messages into another locale
+    std::string localePrefix = lowercase(CONFIG_SECTION) + ".";
+
+    for (const std::string &section : plgCfg.getSections())
+    {
+        std::string locale = lowercase(section);
+
+        if (locale.size() <= localePrefix.size() || locale.compare(0, localePrefix.size(), localePrefix) != 0)
+        {
+            continue;
+        }
+
+        locale.erase(0, localePrefix.size());
+
+        if (config->Messages.findLocale(locale) != NO_LOCALE)
+        {
+            problems.push_back("[" + section + "] is the default locale, its messages belong in [" + CONFIG_SECTION + "]");
+            continue;
+        }
+
+        if (config->Messages.locales() >= MAX_LOCALES)
+        {
+            problems.push_back("too many locales, at most " + std::to_string(MAX_LOCALES) + " may be loaded; [" + section + "] was skipped");
+            continue;
+        }
+
+        readMessages(plgCfg, section, config->Messages, config->Messages.addLocale(locale), problems);
+    }
+
+    config->Messages.finish();
+
+    ScoringPolicy policy = DEFAULT_SCORING_POLICY;
+    int messagesPerTick = DEFAULT_MESSAGES_PER_TICK;
+    int segmentRecords = DEFAULT_CAPTURE_LOG_SEGMENT_RECORDS;
+
+    // A setting that fails to validate keeps its default
+    std::string problem;
+    auto check = [&](bool valid) {
+        if (!valid)
+        {
+            problems.push_back(problem);
+        }
+    };
+
+    check(readIntSetting(plgCfg, "score_losing_team_weight", INT_MIN, policy.losingTeamWeight, problem));
+    check(readIntSetting(plgCfg, "score_team_difference_weight", INT_MIN, policy.teamDifferenceWeight, problem));
+    check(readDoubleSetting(plgCfg, "score_fair_ratio", 0.0, policy.fairRatio, problem));
+    check(readDoubleSetting(plgCfg, "player_stats_flush_interval", 1.0, config->PlayerStatsFlushInterval, problem));
+    check(readIntSetting(plgCfg, "self_cap_multiplier", 0, policy.selfCapMultiplier, problem));
+    check(readIntSetting(plgCfg, "messages_per_tick", 1, messagesPerTick, problem));
+    check(readIntSetting(plgCfg, "debug_log_level", 0, config->DebugLogLevel, problem));
+    check(readIntSetting(plgCfg, "capture_log_segment_records", 1, segmentRecords, problem));
+    check(readIntSetting(plgCfg, "async_listener_threads", 1, config->AsyncListenerThreads, problem));
+    check(readIntSetting(plgCfg, "async_listener_queue_size", 2, config->AsyncListenerQueueSize, problem));
+    check(readBoolSetting(plgCfg, "auto_reload", config->AutoReload, problem));
+    check(readBoolSetting(plgCfg, "trace_enabled", config->TraceEnabled, problem));
+
+    static const char* noticeKeys[NOTICE_CLASSES][2] = {
+        {"cooldown_notice_burst", "cooldown_notice_interval"},
+        {"unfair_team_notice_burst", "unfair_team_notice_interval"},
+        {"unfair_cap_notice_burst", "unfair_cap_notice_interval"},
+    };
+
+    for (size_t i = 0; i < NOTICE_CLASSES; i++)
+    {
+        check(readIntSetting(plgCfg, noticeKeys[i][0], 1, config->NoticeLimits[i].burst, problem));
+        check(readDoubleSetting(plgCfg, noticeKeys[i][1], 0.0, config->NoticeLimits[i].interval, problem));
+    }
+
+    if (!problems.empty())
+    {
+        error = joinProblems(problems);
+
+        if (strict)
+        {
+            return nullptr;
+        }
+    }
+
+    config->Scoring.setPolicy(policy);
+    config->MessagesPerTick = messagesPerTick;
+    config->DebugLogFile = stripQuotes(plgCfg.item(CONFIG_SECTION, "debug_log_file"));
+    config->CaptureLogDir = stripQuotes(plgCfg.item(CONFIG_SECTION, "capture_log_dir"));
+    config->CaptureLogSegmentRecords = segmentRecords;
+    config->StateSnapshotFile = stripQuotes(plgCfg.item(CONFIG_SECTION, "state_snapshot_file"));
+    config->ScoreboardName = stripQuotes(plgCfg.item(CONFIG_SECTION, "scoreboard_shm_name"));
+    config->PlayerStatsFile = stripQuotes(plgCfg.item(CONFIG_SECTION, "player_stats_file"));
+
+    std::string traceDir = stripQuotes(plgCfg.item(CONFIG_SECTION, "trace_dir"));
+
+    if (!traceDir.empty())
+    {
+        config->TraceDir = traceDir;
+    }
+
+    // shm_open() names must start with a slash
+    if (!config->ScoreboardName.empty() && config->ScoreboardName[0] != '/')
+    {
+        config->ScoreboardName.insert(0, "/");
+    }
+
+    return config;
+}
+
+/// Add `change` to the record for the same callsign, ignoring case
+static void mergePlayerStats(std::map<std::string, PlayerStatRecord> &records, const PlayerStatRecord &change)
+{
+    PlayerStatRecord empty = {change.callsign, {}};
+    PlayerStatRecord &record = records.insert(std::make_pair(lowercase(change.callsign), empty)).first->second;
+
+    for (size_t stat = 0; stat < PLAYER_STATS; stat++)
+    {
+        record.values[stat] += change.values[stat];
+    }
+}
+
+/// Append one tab-separated line per record
+static void formatPlayerStats(const std::map<std::string, PlayerStatRecord> &records, std::string &contents)
+{
+    for (const auto &entry : records)
+    {
+        contents += entry.second.callsign;
+
+        for (size_t stat = 0; stat < PLAYER_STATS; stat++)
+        {
+            char value[24];
+            snprintf(value, sizeof(value), "\t%lld", (long long)entry.second.values[stat]);
+            contents += value;
+        }
+
+        contents += '\n';
+    }
+}
+
+PlayerStatsStore::PlayerStatsStore(Logger &_logger) :
+    logger(_logger),
+    flushInterval(DEFAULT_PLAYER_STATS_FLUSH_INTERVAL),
+    nextFlush(0),
+    reportedFailures(0)
+{
+    for (auto &column : columns)
+    {
+        column.fill(0);
+    }
+
+    dirty.fill(false);
+}
+
+PlayerStatsStore::~PlayerStatsStore()
+{
+    stop();
+}
+
+void PlayerStatsStore::open(const std::string &path)
+{
+    close();
+    reap(false);
+
+    filePath = path;
+    nextFlush = bz_getCurrentTime() + flushInterval;
+    reportedFailures = 0;
+
+    // The existing file is read on the writer thread as well, once the writers that were closed are done with theirs
+    writer = std::make_shared<Writer>(path);
+    writer->previous = retired;
+    writer->thread = std::thread(&Writer::run, writer.get());
+}
+
+void PlayerStatsStore::close()
+{
+    if (!writer)
+    {
+        return;
+    }
+
+    // Everything that changed since the last flush is written before the writer stops
+    handOff();
+
+    {
+        std::lock_guard<std::mutex> lock(writer->mutex);
+        writer->stopping = true;
+    }
+
+    writer->wake.notify_all();
+
+    retired.push_back(std::move(writer));
+    writer.reset();
+    filePath.clear();
+}
+
+void PlayerStatsStore::stop()
+{
+    close();
+    reap(true);
+}
+
+bool PlayerStatsStore::isOpen() const
+{
+    return (bool)writer;
+}
+
+const std::string& PlayerStatsStore::path() const
+{
+    return filePath;
+}
+
+void PlayerStatsStore::setFlushInterval(double seconds)
+{
+    flushInterval = seconds;
+}
+
+void PlayerStatsStore::setPlayer(int playerID, const char* callsign)
+{
+    if ((unsigned)playerID >= (unsigned)MAX_PLAYER_SLOTS)
+    {
+        return;
+    }
+
+    // The slot may still hold changes from a previous player if their part event was missed
+    stage(playerID);
+    callsigns[playerID] = callsign ? callsign : "";
+}
+
+void PlayerStatsStore::removePlayer(int playerID)
+{
+    if ((unsigned)playerID >= (unsigned)MAX_PLAYER_SLOTS)
+    {
+        return;
+    }
+
+    stage(playerID);
+    callsigns[playerID].clear();
+}
+
+void PlayerStatsStore::flush(double now)
+{
+    if (!retired.empty())
+    {
+        reap(false);
+    }
+
+    if (!writer || now < nextFlush)
+    {
+        return;
+    }
+
+    nextFlush = now + flushInterval;
+
+    handOff();
+
+    uint64_t failures = writer->failedWrites.load(std::memory_order_relaxed);
+
+    if (failures != reportedFailures)
+    {
+        logger.log(0, "ERROR :: CTF Overseer :: Could not write player stats to %s; they are kept in memory and written with the next batch", filePath.c_str());
+        reportedFailures = failures;
+    }
+}
+
+bool PlayerStatsStore::lookup(const std::string &callsign, PlayerStatRecord &record)
+{
+    std::string key = lowercase(callsign);
+    RecordMap records;
+
+    if (!collect(&key, PlayerStat::Captures, 0, records))
+    {
+        return false;
+    }
+
+    auto found = records.find(key);
+
+    if (found == records.end())
+    {
+        record.callsign.clear();
+        record.values.fill(0);
+    }
+    else
+    {
+        record = found->second;
+    }
+
+    return true;
+}
+
+bool PlayerStatsStore::top(PlayerStat stat, size_t count, std::vector<PlayerStatRecord> &records)
+{
+    RecordMap candidates;
+
+    if (!collect(NULL, stat, count, candidates))
+    {
+        return false;
+    }
+
+    records.clear();
+
+    for (auto &entry : candidates)
+    {
+        records.push_back(std::move(entry.second));
+    }
+
+    size_t shown = std::min(count, records.size());
+
+    std::partial_sort(records.begin(), records.begin() + shown, records.end(), [stat](const PlayerStatRecord &a, const PlayerStatRecord &b) {
+        return a.values[(size_t)stat] > b.values[(size_t)stat];
+    });
+
+    records.resize(shown);
+
+    return true;
+}
+
+void PlayerStatsStore::stage(int playerID)
+{
+    if (!dirty[playerID])
+    {
+        return;
+    }
+
+    PlayerStatRecord record;
+    record.callsign = callsigns[playerID];
+
+    for (size_t stat = 0; stat < PLAYER_STATS; stat++)
+    {
+        record.values[stat] = columns[stat][playerID];
+        columns[stat][playerID] = 0;
+    }
+
+    dirty[playerID] = false;
+    staged.push_back(std::move(record));
+}
+
+void PlayerStatsStore::handOff()
+{
+    for (int playerID = 0; playerID < MAX_PLAYER_SLOTS; playerID++)
+    {
+        stage(playerID);
+    }
+
+    if (staged.empty())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(writer->mutex);
+        writer->pending.insert(writer->pending.end(), std::make_move_iterator(staged.begin()), std::make_move_iterator(staged.end()));
+    }
+
+    staged.clear();
+    writer->wake.notify_all();
+}
+
+/// Gather the totals of `key`, or when it's NULL of everybody who may be among the `count` highest values of `stat`,
+/// along with every change to them that hasn't been merged into the totals yet
+bool PlayerStatsStore::collect(const std::string* key, PlayerStat stat, size_t count, RecordMap &records)
+{
+    RecordMap changes;
+
+    for (const PlayerStatRecord &change : staged)
+    {
+        if (!key || lowercase(change.callsign) == *key)
+        {
+            mergePlayerStats(changes, change);
+        }
+    }
+
+    for (int playerID = 0; playerID < MAX_PLAYER_SLOTS; playerID++)
+    {
+        if (!dirty[playerID] || (key && lowercase(callsigns[playerID]) != *key))
+        {
+            continue;
+        }
+
+        PlayerStatRecord change;
+        change.callsign = callsigns[playerID];
+
+        for (size_t stat = 0; stat < PLAYER_STATS; stat++)
+        {
+            change.values[stat] = columns[stat][playerID];
+        }
+
+        mergePlayerStats(changes, change);
+    }
+
+    std::lock_guard<std::mutex> lock(writer->mutex);
+
+    if (!writer->loaded)
+    {
+        return false;
+    }
+
+    for (const PlayerStatRecord &change : writer->pending)
+    {
+        if (!key || lowercase(change.callsign) == *key)
+        {
+            mergePlayerStats(changes, change);
+        }
+    }
+
+    for (const auto &change : changes)
+    {
+        auto total = writer->totals.find(change.first);
+
+        if (total != writer->totals.end())
+        {
+            mergePlayerStats(records, total->second);
+        }
+
+        mergePlayerStats(records, change.second);
+    }
+
+    if (key)
+    {
+        auto total = writer->totals.find(*key);
+
+        if (total != writer->totals.end())
+        {
+            records.insert(*total);
+        }
+
+        return true;
+    }
+
+    // Anybody else has no changes and totals no higher than the leaders', so they can't be in the top `count`
+    const Ranking &ranking = writer->rankings[(size_t)stat];
+    auto leader = ranking.begin();
+
+    for (size_t i = 0; i < count && leader != ranking.end(); i++, leader++)
+    {
+        records.insert(*writer->totals.find(leader->second));
+    }
+
+    return true;
+}
+
+/// Join the writers that were closed once they're done, or right away when `wait` is set
+void PlayerStatsStore::reap(bool wait)
+{
+    for (auto closed = retired.begin(); closed != retired.end();)
+    {
+        Writer &done = **closed;
+        bool lost;
+
+        {
+            std::unique_lock<std::mutex> lock(done.mutex);
+
+            if (!done.finished && !wait)
+            {
+                closed++;
+                continue;
+            }
+
+            done.wake.wait(lock, [&done] { return done.finished; });
+            lost = done.lost;
+        }
+
+        done.thread.join();
+
+        if (lost)
+        {
+            logger.log(0, "ERROR :: CTF Overseer :: Could not write player stats to %s before closing it; the changes since its last write are lost", done.path.c_str());
+        }
+
+        closed = retired.erase(closed);
+    }
+}
+
+PlayerStatsStore::Writer::Writer(const std::string &_path) :
+    path(_path),
+    stopping(false),
+    loaded(false),
+    finished(false),
+    lost(false),
+    failedWrites(0)
+{
+}
+
+void PlayerStatsStore::Writer::run()
+{
+    TraceThread traceThread("player stats writer");
+
+    for (const auto &earlier : previous)
+    {
+        std::unique_lock<std::mutex> lock(earlier->mutex);
+        earlier->wake.wait(lock, [&earlier] { return earlier->finished; });
+    }
+
+    previous.clear();
+
+    RecordMap existing;
+    size_t lines = 0;
+    bool intact = load(existing, lines);
+    std::array<Ranking, PLAYER_STATS> ranked;
+
+    for (const auto &entry : existing)
+    {
+        for (size_t stat = 0; stat < PLAYER_STATS; stat++)
+        {
+            ranked[stat].emplace(entry.second.values[stat], entry.first);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        totals.swap(existing);
+        rankings.swap(ranked);
+        loaded = true;
+    }
+
+    std::vector<PlayerStatRecord> batch;
+    RecordMap changes;
+    // A file that was set aside as a backup is replaced right away, and one without a header can't be appended to
+    bool unsaved = !intact;
+    bool rewrite = !intact || lines == 0;
+
+    while (true)
+    {
+        bool stop;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || !pending.empty(); });
+
+            stop = stopping;
+            batch.swap(pending);
+
+            for (const PlayerStatRecord &change : batch)
+            {
+                merge(change);
+            }
+        }
+
+        // Several changes for the same callsign are appended as one line
+        for (const PlayerStatRecord &change : batch)
+        {
+            mergePlayerStats(changes, change);
+        }
+
+        unsaved = unsaved || !batch.empty();
+        batch.clear();
+
+        // Only this thread changes `totals`, so it can be read without holding the lock while the file is written
+        if (unsaved)
+        {
+            bool compact = rewrite || lines >= PLAYER_STATS_COMPACT_RATIO * totals.size();
+
+            if (compact ? save(totals) : append(changes))
+            {
+                lines = compact ? totals.size() : lines + changes.size();
+                unsaved = false;
+                rewrite = false;
+            }
+            else
+            {
+                // A failed append may have left part of a line behind, and the totals hold the changes it was missing
+                rewrite = true;
+                failedWrites.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        changes.clear();
+
+        if (stop)
+        {
+            break;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+        lost = unsaved;
+    }
+
+    wake.notify_all();
+}
+
+/// Add `change` to the totals and move the callsign to its new place in the rankings; `mutex` must be held
+void PlayerStatsStore::Writer::merge(const PlayerStatRecord &change)
+{
+    PlayerStatRecord empty = {change.callsign, {}};
+    auto inserted = totals.insert(std::make_pair(lowercase(change.callsign), empty));
+    const std::string &key = inserted.first->first;
+    PlayerStatRecord &record = inserted.first->second;
+
+    for (size_t stat = 0; stat < PLAYER_STATS; stat++)
+    {
+        if (!inserted.second)
+        {
+            if (change.values[stat] == 0)
+            {
+                continue;
+            }
+
+            rankings[stat].erase(std::make_pair(record.values[stat], key));
+        }
+
+        record.values[stat] += change.values[stat];
+        rankings[stat].emplace(record.values[stat], key);
+    }
+}
+
+/// Read the file, adding up the lines for the same callsign; false when it couldn't be read completely and was set aside
+bool PlayerStatsStore::Writer::load(RecordMap &records, size_t &lines)
+{
+    FILE* file = fopen(path.c_str(), "r");
+
+    if (!file)
+    {
+        return true;
+    }
+
+    char line[512];
+    bool firstLine = true;
+    bool malformed = false;
+
+    while (fgets(line, sizeof(line), file))
+    {
+        size_t length = strcspn(line, "\r\n");
+
+        // A line without an end was cut short by an append that didn't finish
+        if (line[length] == '\0')
+        {
+            malformed = true;
+            continue;
+        }
+
+        line[length] = '\0';
+
+        char* field = strchr(line, '\t');
+
+        // The first line names the columns
+        if (firstLine && strncmp(line, "callsign\t", 9) == 0)
+        {
+            firstLine = false;
+            continue;
+        }
+
+        firstLine = false;
+
+        if (!field || field == line)
+        {
+            malformed = malformed || line[0] != '\0';
+            continue;
+        }
+
+        PlayerStatRecord record = {std::string(line, field - line), {}};
+
+        // Columns missing at the end, e.g. from a file written before a statistic was added, are left at 0
+        for (size_t stat = 0; stat < PLAYER_STATS && *field == '\t'; stat++)
+        {
+            record.values[stat] = strtoll(field + 1, &field, 10);
+        }
+
+        malformed = malformed || *field != '\0';
+
+        mergePlayerStats(records, record);
+        lines++;
+    }
+
+    fclose(file);
+
+    // Keep a copy of a file that couldn't be read completely, since it's about to be replaced
+    if (malformed)
+    {
+        std::string copy = path + ".bak";
+        remove(copy.c_str());
+
+        if (rename(path.c_str(), copy.c_str()) != 0)
+        {
+            failedWrites.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    return !malformed;
+}
+
+/// Replace the file with one line per callsign
+bool PlayerStatsStore::Writer::save(const RecordMap &records)
+{
+    std::string contents = "callsign";
+
+    for (size_t stat = 0; stat < PLAYER_STATS; stat++)
+    {
+        contents += '\t';
+        contents += PLAYER_STAT_NAMES[stat];
+    }
+
+    contents += '\n';
+    formatPlayerStats(records, contents);
+
+    std::string temporary = path + ".tmp";
+    FILE* file = fopen(temporary.c_str(), "w");
+
+    if (!file)
+    {
+        return false;
+    }
+
+    bool written = fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+    written = fclose(file) == 0 && written;
+
+#ifdef _WIN32
+    // rename() won't replace an existing file on Windows
+    if (written)
+    {
+        remove(path.c_str());
+    }
+#endif
+
+    if (!written || rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        remove(temporary.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+/// Add one line per changed callsign to the end of the file
+bool PlayerStatsStore::Writer::append(const RecordMap &changes)
+{
+    std::string contents;
+    formatPlayerStats(changes, contents);
+
+    FILE* file = fopen(path.c_str(), "a");
+
+    if (!file)
+    {
+        return false;
+    }
+
+    bool written = fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+
+    return fclose(file) == 0 && written;
+}
+
+ConfigReloader::ConfigReloader() :
+    stopping(false),
+    pending(false),
+    pendingRequester(BZ_SERVER),
+    pendingQuiet(true),
+    autoReload(false),
+    resultReady(false),
+    watchFD(-1),
+    watchFailed(false),
+    wakeFD(-1)
+{
+}
+
+ConfigReloader::~ConfigReloader()
+{
+    stop();
+}
+
+void ConfigReloader::start(const std::string &path)
+{
+    stop();
+
+    filePath = path;
+
+    size_t slash = path.find_last_of("/\\");
+    fileDirectory = (slash == std::string::npos) ? "." : path.substr(0, slash);
+    fileName = (slash == std::string::npos) ? path : path.substr(slash + 1);
+
+    stopping = false;
+    pending = false;
+
+#ifdef __linux__
+    wakeFD = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+
+    worker = std::thread(&ConfigReloader::run, this);
+}
+
+void ConfigReloader::stop()
+{
+    if (!worker.joinable())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+
+    notify();
+    worker.join();
+
+#ifdef __linux__
+    if (wakeFD >= 0)
+    {
+        close(wakeFD);
+        wakeFD = -1;
+    }
+#endif
+
+    std::atomic_store(&result, std::shared_ptr<const ConfigurationLoad>());
+    resultReady = false;
+}
+
+void ConfigReloader::request(int playerID, bool quiet)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending = true;
+        pendingRequester = playerID;
+        pendingQuiet = quiet;
+    }
+
+    notify();
+}
+
+void ConfigReloader::setAutoReload(bool enabled)
+{
+    // The worker only starts or stops watching the file when it wakes up
+    if (autoReload.exchange(enabled) != enabled && worker.joinable())
+    {
+        notify();
+    }
+}
+
+std::shared_ptr<const ConfigurationLoad> ConfigReloader::takeResult()
+{
+    if (!resultReady.load(std::memory_order_acquire))
+    {
+        return nullptr;
+    }
+
+    resultReady = false;
+
+    return std::atomic_exchange(&result, std::shared_ptr<const ConfigurationLoad>());
+}
+
+void ConfigReloader::run()
+{
+    TraceThread traceThread("config reloader");
+
+    while (true)
+    {
+        updateWatch();
+
+        bool changed = waitForChange();
+        std::shared_ptr<ConfigurationLoad> load = std::make_shared<ConfigurationLoad>();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (stopping)
+            {
+                break;
+            }
+
+            if (pending)
+            {
+                pending = false;
+                load->requestedBy = pendingRequester;
+                load->quiet = pendingQuiet;
+            }
+            else if (!changed)
+            {
+                continue;
+            }
+            else
+            {
+                load->requestedBy = BZ_SERVER;
+                load->quiet = false;
+            }
+        }
+
+        if (load->requestedBy == BZ_SERVER)
+        {
+            // Editors often save in several steps; give them a moment to finish before reading the file
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            fileChanged();
+        }
+
+        load->config = buildConfiguration(filePath, true, load->error);
+
+        std::atomic_store(&result, std::shared_ptr<const ConfigurationLoad>(load));
+        resultReady.store(true, std::memory_order_release);
+    }
+
+    autoReload = false;
+    updateWatch();
+}
+
+#ifdef __linux__
+void ConfigReloader::notify()
+{
+    if (wakeFD < 0)
+    {
+        wake.notify_one();
+        return;
+    }
+
+    uint64_t one = 1;
+
+    // A write only fails when the counter is about to overflow, in which case the worker is already due to wake up
+    ssize_t written = write(wakeFD, &one, sizeof(one));
+    (void)written;
+}
+
+/// Block until notify() is called or, when auto reloading, the configuration file changes
+bool ConfigReloader::waitForChange()
+{
+    if (wakeFD < 0)
+    {
+        // Without an eventfd to interrupt poll() with, requests are still served but the file isn't watched
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [this]() { return stopping || pending; });
+
+        return false;
+    }
+
+    struct pollfd fds[2] = {{wakeFD, POLLIN, 0}, {watchFD, POLLIN, 0}};
+    nfds_t count = (watchFD >= 0) ? 2 : 1;
+
+    while (poll(fds, count, -1) < 0 && errno == EINTR)
+    {
+    }
+
+    // Reading resets the counter; run() checks what it was woken for under the mutex
+    if (fds[0].revents & POLLIN)
+    {
+        uint64_t wakeups;
+        ssize_t length = read(wakeFD, &wakeups, sizeof(wakeups));
+        (void)length;
+    }
+
+    return count == 2 && (fds[1].revents & POLLIN) && fileChanged();
+}
+
+void ConfigReloader::updateWatch()
+{
+    bool wanted = autoReload.load();
+
+    if (!wanted)
+    {
+        watchFailed = false;
+
+        if (watchFD >= 0)
+        {
+            close(watchFD);
+            watchFD = -1;
+        }
+
+        return;
+    }
+
+    if (watchFD >= 0 || watchFailed)
+    {
+        return;
+    }
+
+    // Watch the directory rather than the file so editors that save by renaming a new file into place are noticed
+    watchFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if (watchFD >= 0 && inotify_add_watch(watchFD, fileDirectory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0)
+    {
+        close(watchFD);
+        watchFD = -1;
+    }
+
+    watchFailed = (watchFD < 0);
+}
+
+bool ConfigReloader::fileChanged()
+{
+    if (watchFD < 0)
+    {
+        return false;
+    }
+
+    alignas(struct inotify_event) char buffer[4096];
+    bool changed = false;
+    ssize_t length;
+
+    while ((length = read(watchFD, buffer, sizeof(buffer))) > 0)
+    {
+        for (char* cursor = buffer; cursor < buffer + length; )
+        {
+            const struct inotify_event* event = (const struct inotify_event*)cursor;
+
+            if (event->len > 0 && fileName == event->name)
+            {
+                changed = true;
+            }
+
+            cursor += sizeof(struct inotify_event) + event->len;
+        }
+    }
+
+    return changed;
+}
+#else
+void ConfigReloader::notify()
+{
+    wake.notify_one();
+}
+
+bool ConfigReloader::waitForChange()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    wake.wait(lock, [this]() { return stopping || pending; });
+
+    return false;
+}
+
+void ConfigReloader::updateWatch()
+{
+}
+
+bool ConfigReloader::fileChanged()
+{
+    return false;
+}
+#endif
+
+void LatencyHistogram::reset()
+{
+    buckets.fill(0);
+    samples = 0;
+    totalNs = 0;
+    maxNs = 0;
+}
+
+void LatencyHistogram::record(uint64_t ns)
+{
+    int bucket = 0;
+
+    while ((ns >> (bucket + 1)) != 0 && bucket < BUCKETS - 1)
+    {
+        bucket++;
+    }
+
+    buckets[bucket]++;
+    samples++;
+    totalNs += ns;
+    maxNs = std::max(maxNs, ns);
+}
+
+uint64_t LatencyHistogram::percentile(double fraction) const
+{
+    uint64_t target = (uint64_t)(fraction * samples);
+    uint64_t seen = 0;
+
+    for (int bucket = 0; bucket < BUCKETS; bucket++)
+    {
+        seen += buckets[bucket];
+
+        if (seen > target)
+        {
+            // Report the bucket's upper bound, but never more than the largest sample actually seen
+            return std::min(maxNs, ((uint64_t)2 << bucket) - 1);
+        }
+    }
+
+    return maxNs;
+}
+
+PluginStats::PluginStats()
+{
+    reset();
+}
+
+void PluginStats::record(StatSection section, uint64_t ns)
+{
+    histograms[(size_t)section].record(ns);
+}
+
+void PluginStats::reset()
+{
+    for (LatencyHistogram &histogram : histograms)
+    {
+        histogram.reset();
+    }
+
+    calls.fill(0);
+    counters.fill(0);
+    sampleTick = 0;
+    since = bz_getCurrentTime();
+}
+
+void PluginStats::report(int playerID) const
+{
+    static const char* counterNames[(size_t)StatCounter::Count] = {
+        "grabs allowed", "grabs denied (cooldown)", "caps allowed", "caps denied (self)", "caps denied (unfair)",
+        "cooldown warnings", "unfair team warnings", "cooldown warnings dropped", "unfair team warnings dropped",
+        "unfair cap notices dropped", "listener calls", "async listener events", "async listener drops",
+        "queued messages dropped",
+    };
+
+    bz_sendTextMessagef(BZ_SERVER, playerID, "CTF Overseer stats for the last %.0f seconds (latency in ns, sampled 1 in %d)", bz_getCurrentTime() - since, LATENCY_SAMPLE_INTERVAL);
+    bz_sendTextMessagef(BZ_SERVER, playerID, "  %-16s %10s %8s %8s %8s %8s", "section", "calls", "mean", "p50", "p99", "max");
+
+    for (size_t i = 0; i < histograms.size(); i++)
+    {
+        const LatencyHistogram &histogram = histograms[i];
+
+        if (calls[i] == 0)
+        {
+            continue;
+        }
+
+        bz_sendTextMessagef(BZ_SERVER, playerID, "  %-16s %10llu %8llu %8llu %8llu %8llu", STAT_SECTION_NAMES[i],
+            (unsigned long long)calls[i], (unsigned long long)(histogram.samples ? histogram.totalNs / histogram.samples : 0),
+            (unsigned long long)histogram.percentile(0.5), (unsigned long long)histogram.percentile(0.99),
+            (unsigned long long)histogram.maxNs);
+    }
+
+    for (size_t i = 0; i < counters.size(); i++)
+    {
+        bz_sendTextMessagef(BZ_SERVER, playerID, "  %-24s %llu", counterNames[i], (unsigned long long)counters[i]);
+    }
+}
+
+std::atomic<bool> Tracer::active(false);
+
+Tracer::Tracer() :
+    epoch(Clock::now())
+{
+}
+
+void Tracer::setEnabled(bool enable)
+{
+    active.store(enable, std::memory_order_relaxed);
+}
+
+Tracer::ThreadBuffer& Tracer::buffer()
+{
+    if (!threadTraceBuffer)
+    {
+        std::lock_guard<std::mutex> guard(buffersLock);
+        ThreadBuffer* thread;
+
+        // A reused buffer still holds the spans of the thread that exited; they're dropped rather than mislabelled
+        if (!idleBuffers.empty())
+        {
+            thread = idleBuffers.back();
+            idleBuffers.pop_back();
+            thread->head.store(0, std::memory_order_relaxed);
+        }
+        else
+        {
+            buffers.emplace_back(new ThreadBuffer());
+            thread = buffers.back().get();
+        }
+
+        thread->name.store(threadTraceName, std::memory_order_relaxed);
+        threadTraceBuffer = thread;
+    }
+
+    return *static_cast<ThreadBuffer*>(threadTraceBuffer);
+}
+
+void Tracer::nameThread(const char* name)
+{
+    // Threads that never record a span never get a buffer
+    threadTraceName = name;
+
+    if (threadTraceBuffer)
+    {
+        buffer().name.store(name, std::memory_order_relaxed);
+    }
+}
+
+void Tracer::releaseThread()
+{
+    if (threadTraceBuffer)
+    {
+        std::lock_guard<std::mutex> guard(buffersLock);
+        idleBuffers.push_back(static_cast<ThreadBuffer*>(threadTraceBuffer));
+    }
+
+    threadTraceBuffer = NULL;
+    threadTraceName = NULL;
+}
+
+void Tracer::record(const char* name, const char* category, Clock::time_point start, Clock::time_point end)
+{
+    ThreadBuffer &thread = buffer();
+    uint64_t index = thread.head.load(std::memory_order_relaxed);
+    Span &span = thread.spans[index & (TRACE_BUFFER_EVENTS - 1)];
+
+    span.name.store(name, std::memory_order_relaxed);
+    span.category.store(category, std::memory_order_relaxed);
+    span.start.store(std::chrono::duration_cast<std::chrono::nanoseconds>(start - epoch).count(), std::memory_order_relaxed);
+    span.duration.store(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count(), std::memory_order_relaxed);
+
+    thread.head.store(index + 1, std::memory_order_release);
+}
+
+void Tracer::capture(double seconds, Capture &out)
+{
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - epoch).count();
+    std::vector<Capture::Span> &spans = out.spans;
+
+    out.since = now - (int64_t)(seconds * 1e9);
+    spans.clear();
+    out.threadNames.clear();
+
+    std::lock_guard<std::mutex> guard(buffersLock);
+
+    for (size_t t = 0; t < buffers.size(); t++)
+    {
+        const ThreadBuffer &thread = *buffers[t];
+        uint64_t head = thread.head.load(std::memory_order_acquire);
+        uint64_t first = head > TRACE_BUFFER_EVENTS ? head - TRACE_BUFFER_EVENTS : 0;
+        size_t copied = spans.size();
+
+        out.threadNames.push_back(thread.name.load(std::memory_order_relaxed));
+
+        for (uint64_t i = first; i < head; i++)
+        {
+            const Span &span = thread.spans[i & (TRACE_BUFFER_EVENTS - 1)];
+
+            spans.push_back(Capture::Span{span.name.load(std::memory_order_relaxed), span.category.load(std::memory_order_relaxed),
+                span.start.load(std::memory_order_relaxed), span.duration.load(std::memory_order_relaxed), t});
+        }
+
+        // Throw away the oldest spans if the thread wrapped around onto them while they were being copied
+        uint64_t after = thread.head.load(std::memory_order_acquire);
+
+        if (after >= first + TRACE_BUFFER_EVENTS)
+        {
+            size_t overwritten = std::min<uint64_t>(head - first, after + 1 - TRACE_BUFFER_EVENTS - first);
+            spans.erase(spans.begin() + copied, spans.begin() + copied + overwritten);
+        }
+    }
+}
+
+bool Tracer::write(const std::string &path, const Capture &capture, size_t &written)
+{
+    const std::vector<const char*> &threadNames = capture.threadNames;
+    FILE* file = fopen(path.c_str(), "w");
+
+    if (!file)
+    {
+        return false;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"bzfs (CTF Overseer)\"}}");
+
+    for (size_t t = 0; t < threadNames.size(); t++)
+    {
+        fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", (int)t + 1,
+            threadNames[t] ? threadNames[t] : "unnamed");
+    }
+
+    written = 0;
+
+    for (const Capture::Span &span : capture.spans)
+    {
+        if (span.start + span.duration < capture.since)
+        {
+            continue;
+        }
+
+        // Chrome traces are in microseconds; keep the nanoseconds as fractions
+        fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", span.name,
+            span.category, (int)span.thread + 1, span.start / 1e3, span.duration / 1e3);
+        written++;
+    }
+
+    fprintf(file, "\n]}\n");
+
+    return fclose(file) == 0;
+}
+
+TraceSpan::TraceSpan(const char* _name, const char* _category) :
+    name(_name),
+    category(_category),
+    active(Tracer::enabled())
+{
+    if (active)
+    {
+        start = Tracer::Clock::now();
+    }
+}
+
+TraceSpan::~TraceSpan()
+{
+    if (active)
+    {
+        tracer.record(name, category, start, Tracer::Clock::now());
+    }
+}
+
+TraceThread::TraceThread(const char* name)
+{
+    tracer.nameThread(name);
+}
+
+TraceThread::~TraceThread()
+{
+    tracer.releaseThread();
+}
+
+TraceDumpWriter::TraceDumpWriter() :
+    finished(false),
+    window(0),
+    requester(BZ_SERVER),
+    written(0),
+    succeeded(false)
+{
+}
+
+TraceDumpWriter::~TraceDumpWriter()
+{
+    stop();
+}
+
+bool TraceDumpWriter::start(const std::string &path, double seconds, int requestedBy)
+{
+    if (worker.joinable())
+    {
+        return false;
+    }
+
+    // Copying the spans is only a memory copy; formatting and writing them is what's left to the thread
+    tracer.capture(seconds, capture);
+
+    filePath = path;
+    window = seconds;
+    requester = requestedBy;
+    finished = false;
+    worker = std::thread(&TraceDumpWriter::run, this);
+
+    return true;
+}
+
+void TraceDumpWriter::reportFinished()
+{
+    if (!worker.joinable() || !finished.load(std::memory_order_acquire))
+    {
+        return;
+    }
+
+    worker.join();
+    capture = Tracer::Capture();
+
+    if (requester < 0)
+    {
+        return;
+    }
+
+    if (succeeded)
+    {
+        bz_sendTextMessagef(BZ_SERVER, requester, "Wrote %u spans from the last %.0f seconds to %s", (unsigned)written, window, filePath.c_str());
+    }
+    else
+    {
+        bz_sendTextMessagef(BZ_SERVER, requester, "Could not write the trace to %s", filePath.c_str());
+    }
+}
+
+void TraceDumpWriter::stop()
+{
+    if (worker.joinable())
+    {
+        worker.join();
+    }
+
+    capture = Tracer::Capture();
+}
+
+void TraceDumpWriter::run()
+{
+    TraceThread traceThread("trace writer");
+
+    written = 0;
+    succeeded = Tracer::write(filePath, capture, written);
+    finished.store(true, std::memory_order_release);
+}
+
+ScopedLatency::~ScopedLatency()
+{
+    stats.called(section);
+
+    if (!sampled && !traced)
+    {
+        return;
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    if (sampled)
+    {
+        stats.record(section, (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    }
+
+    if (traced)
+    {
+        tracer.record(STAT_SECTION_NAMES[(size_t)section], "event", start, end);
+    }
+}
+
+NoticeLimiter::NoticeLimiter()
+{
+    rates.fill(Rate{0.0, 0.0});
+    nextToken.fill(NEVER);
+}
+
+void NoticeLimiter::configure(MessageClass kind, const NoticeLimit &limit)
+{
+    Rate &rate = rates[(size_t)kind - FIRST_NOTICE_CLASS];
+
+    rate.interval = std::max(0.0, limit.interval);
+    rate.tolerance = std::max(0, limit.burst - 1) * rate.interval;
+}
+
+bool NoticeLimiter::allow(int playerID, MessageClass kind, double now)
+{
+    size_t notice = (size_t)kind - FIRST_NOTICE_CLASS;
+    const Rate &rate = rates[notice];
+
+    // Notices only go to players, who always have a slot
+    if ((unsigned)playerID >= (unsigned)MAX_PLAYER_SLOTS)
+    {
+        return false;
+    }
+
+    if (rate.interval <= 0)
+    {
+        return true;
+    }
+
+    double &next = nextToken[playerID * NOTICE_CLASSES + notice];
+    double start = std::max(next, now);
+
+    if (start - now > rate.tolerance)
+    {
+        return false;
+    }
+
+    next = start + rate.interval;
+
+    return true;
+}
+
+void NoticeLimiter::resetPlayer(int playerID)
+{
+    if (0 <= playerID && playerID < MAX_PLAYER_SLOTS)
+    {
+        std::fill_n(nextToken.begin() + playerID * NOTICE_CLASSES, NOTICE_CLASSES, NEVER);
+    }
+}
+
+OutboundMessageQueue::OutboundMessageQueue() :
+    slots(16),
+    head(0),
+    tail(0),
+    dropped(0)
+{
+    noticeIndex.fill(SIZE_MAX);
+}
+
+size_t* OutboundMessageQueue::pendingNotice(int recipient, MessageClass kind)
+{
+    if ((size_t)kind < FIRST_NOTICE_CLASS)
+    {
+        return nullptr;
+    }
+
+    size_t notice = (size_t)kind - FIRST_NOTICE_CLASS;
+
+    if (recipient == BZ_ALLUSERS)
+    {
+        return &noticeIndex[MAX_PLAYER_SLOTS * NOTICE_CLASSES + notice];
+    }
+
+    if ((unsigned)recipient < (unsigned)MAX_PLAYER_SLOTS)
+    {
+        return &noticeIndex[recipient * NOTICE_CLASSES + notice];
+    }
+
+    return nullptr;
+}
+
+std::string& OutboundMessageQueue::enqueue(int recipient, MessageClass kind, bool continuesBroadcast)
+{
+    size_t *pending = pendingNotice(recipient, kind);
+
+    // A player only needs the latest copy of a notice that hasn't been sent yet
+    if (pending && *pending - head < size() && slot(*pending).recipient == recipient)
+    {
+        Message &message = slot(*pending);
+        message.text.clear();
+
+        return message.text;
+    }
+
+    if (size() == slots.size())
+    {
+        if (slots.size() < OUTBOX_CAPACITY)
+        {
+            std::vector<Message> grown(slots.size() * 2);
+
+            for (size_t i = 0; i < slots.size(); i++)
+            {
+                grown[i] = std::move(slot(head + i));
+            }
+
+            tail = slots.size();
+            head = 0;
+            slots.swap(grown);
+        }
+        else
+        {
+            evictOldest();
+        }
+    }
+
+    if (pending)
+    {
+        *pending = tail;
+    }
+
+    Message &message = slot(tail++);
+    message.recipient = recipient;
+    message.kind = kind;
+    message.continuesBroadcast = continuesBroadcast;
+    message.text.clear();
+
+    return message.text;
+}
+
+size_t OutboundMessageQueue::drain(size_t budget)
+{
+    if (head == tail)
+    {
+        return 0;
+    }
+
+    TraceSpan span("drainMessages", "message");
+    size_t sent = 0;
+
+    // Whether the broadcast the last message belonged to has been counted yet; a broadcast is never split between ticks
+    bool counted = false;
+
+    while (head != tail && (sent < budget || slot(head).continuesBroadcast))
+    {
+        Message &message = slot(head++);
+
+        if (!message.continuesBroadcast)
+        {
+            counted = false;
+        }
+
+        if (message.recipient == BZ_NULLUSER || message.text.empty())
+        {
+            continue;
+        }
+
+        bz_sendTextMessage(BZ_SERVER, message.recipient, message.text.c_str());
+
+        if (!counted)
+        {
+            sent++;
+            counted = true;
+        }
+    }
+
+    return sent;
+}
+
+void OutboundMessageQueue::evictOldest()
+{
+    size_t victim = tail;
+    size_t oldestNotice = tail;
+
+    // Messages whose recipient already left cost nothing to drop, so they go first, then the oldest notice
+    for (size_t i = head; i != tail && victim == tail; i++)
+    {
+        Message &message = slot(i);
+
+        if (message.recipient == BZ_NULLUSER)
+        {
+            victim = i;
+        }
+        else if (oldestNotice == tail && (size_t)message.kind >= FIRST_NOTICE_CLASS)
+        {
+            oldestNotice = i;
+        }
+    }
+
+    if (victim == tail)
+    {
+        victim = (oldestNotice != tail) ? oldestNotice : head;
+    }
+
+    Message &evicted = slot(victim);
+    size_t *pending = pendingNotice(evicted.recipient, evicted.kind);
+
+    // The next copy of a broadcast takes over as the one that's counted against the budget
+    if (!evicted.continuesBroadcast && victim + 1 != tail)
+    {
+        slot(victim + 1).continuesBroadcast = false;
+    }
+
+    if (evicted.recipient != BZ_NULLUSER)
+    {
+        dropped++;
+
+        if (pending && *pending == victim)
+        {
+            *pending = SIZE_MAX;
+        }
+    }
+
+    // Close the gap by moving everything queued before the victim one slot later; order is kept, and the text buffers
+    // are swapped rather than freed
+    for (size_t i = victim; i != head; i--)
+    {
+        std::swap(slot(i), slot(i - 1));
+
+        Message &moved = slot(i);
+        pending = pendingNotice(moved.recipient, moved.kind);
+
+        if (pending && *pending == i - 1)
+        {
+            *pending = i;
+        }
+    }
+
+    head++;
+}
+
+void OutboundMessageQueue::dropRecipient(int playerID)
+{
+    // The player slot may be reused by someone else before the queue is drained
+    for (size_t i = head; i != tail; i++)
+    {
+        if (slot(i).recipient == playerID)
+        {
+            slot(i).recipient = BZ_NULLUSER;
+        }
+    }
+}
+
+CaptureEventQueue::CaptureEventQueue(size_t capacity) :
+    cells(capacity),
+    mask(capacity - 1),
+    enqueuePos(0),
+    dequeuePos(0)
+{
+    for (size_t i = 0; i < capacity; i++)
+    {
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+bool CaptureEventQueue::push(const std::shared_ptr<AsyncCaptureListener> &listener, const CaptureDispatch &capture)
+{
+    size_t position = enqueuePos.load(std::memory_order_relaxed);
+    Cell* cell;
+
+    while (true)
+    {
+        cell = &cells[position & mask];
+        intptr_t difference = (intptr_t)cell->sequence.load(std::memory_order_acquire) - (intptr_t)position;
+
+        if (difference == 0)
+        {
+            if (enqueuePos.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (difference < 0)
+        {
+            return false;
+        }
+        else
+        {
+            position = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    cell->delivery.listener = listener;
+    cell->delivery.capture = capture;
+    cell->sequence.store(position + 1, std::memory_order_release);
+
+    return true;
+}
+
+bool CaptureEventQueue::pop(Delivery &delivery)
+{
+    size_t position = dequeuePos.load(std::memory_order_relaxed);
+    Cell &cell = cells[position & mask];
+
+    if (cell.sequence.load(std::memory_order_acquire) != position + 1)
+    {
+        return false;
+    }
+
+    delivery.listener = std::move(cell.delivery.listener);
+    delivery.capture = cell.delivery.capture;
+    cell.sequence.store(position + mask + 1, std::memory_order_release);
+    dequeuePos.store(position + 1, std::memory_order_relaxed);
+
+    return true;
+}
+
+size_t CaptureEventQueue::size() const
+{
+    return enqueuePos.load(std::memory_order_relaxed) - dequeuePos.load(std::memory_order_relaxed);
+}
+
+AsyncListenerPool::AsyncListenerPool() :
+    running(false),
+    threadCount(DEFAULT_ASYNC_LISTENER_THREADS),
+    queueCapacity(DEFAULT_ASYNC_LISTENER_QUEUE_SIZE)
+{
+}
+
+AsyncListenerPool::~AsyncListenerPool()
+{
+    stop();
+}
+
+void AsyncListenerPool::configure(int threads, int queueSize)
+{
+    threadCount = std::max(1, threads);
+    queueCapacity = 2;
+
+    while (queueCapacity < (size_t)std::min(queueSize, MAX_ASYNC_LISTENER_QUEUE_SIZE))
+    {
+        queueCapacity <<= 1;
+    }
+}
+
+bool AsyncListenerPool::isRunning() const
+{
+    return running.load(std::memory_order_relaxed);
+}
+
+void AsyncListenerPool::start()
+{
+    if (isRunning())
+    {
+        return;
+    }
+
+    running = true;
+
+    for (int i = 0; i < threadCount; i++)
+    {
+        workers.emplace_back(new Worker(queueCapacity));
+    }
+
+    for (auto &worker : workers)
+    {
+        worker->thread = std::thread(&AsyncListenerPool::run, this, std::ref(*worker));
+    }
+}
+
+void AsyncListenerPool::stop()
+{
+    if (!isRunning())
+    {
+        return;
+    }
+
+    running = false;
+
+    for (auto &worker : workers)
+    {
+        {
+            std::lock_guard<std::mutex> guard(worker->wakeLock);
+            worker->wake.notify_one();
+        }
+
+        worker->thread.join();
+    }
+
+    workers.clear();
+}
+
+AsyncListenerPool::Worker& AsyncListenerPool::workerFor(const AsyncCaptureListener &listener) const
+{
+    return *workers[listener.handle % workers.size()];
+}
+
+bool AsyncListenerPool::enqueue(const std::shared_ptr<AsyncCaptureListener> &listener, const CaptureDispatch &capture)
+{
+    Worker &worker = workerFor(*listener);
+
+    // Count it before it becomes visible so the worker can never take `pending` below zero
+    listener->pending.fetch_add(1, std::memory_order_relaxed);
+
+    if (!worker.queue.push(listener, capture))
+    {
+        listener->pending.fetch_sub(1, std::memory_order_relaxed);
+        listener->dropped.fetch_add(1, std::memory_order_relaxed);
+
+        return false;
+    }
+
+    size_t depth = worker.queue.size();
+
+    if (depth > worker.highWater.load(std::memory_order_relaxed))
+    {
+        worker.highWater.store(depth, std::memory_order_relaxed);
+    }
+
+    // Pairs with the fence in run(): either the worker sees this event before it sleeps, or this sees it sleeping
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (worker.sleeping.load(std::memory_order_relaxed))
+    {
+        std::lock_guard<std::mutex> guard(worker.wakeLock);
+        worker.wake.notify_one();
+    }
+
+    return true;
+}
+
+void AsyncListenerPool::retire(AsyncCaptureListener &listener)
+{
+    listener.removed = true;
+
+    if (!isRunning())
+    {
+        listener.v1 = nullptr;
+        listener.v2 = nullptr;
+
+        return;
+    }
+
+    // Wait out a callback that's already running, then drop the callbacks here so a plug-in may unload right after
+    std::lock_guard<std::mutex> guard(workerFor(listener).invokeLock);
+
+    listener.v1 = nullptr;
+    listener.v2 = nullptr;
+}
+
+void AsyncListenerPool::run(Worker &worker)
+{
+    CaptureEventQueue::Delivery delivery;
+
+    TraceThread traceThread("async listener worker");
+
+    while (true)
+    {
+        // Read `running` before draining so nothing queued before stop() is left behind
+        bool keepRunning = running.load(std::memory_order_acquire);
+
+        while (worker.queue.pop(delivery))
+        {
+            AsyncCaptureListener &listener = *delivery.listener;
+
+            {
+                std::lock_guard<std::mutex> guard(worker.invokeLock);
+
+                if (!listener.removed.load(std::memory_order_relaxed))
+                {
+                    TraceSpan span("asyncListener", "listener");
+
+                    const CaptureDispatch &capture = delivery.capture;
+
+                    if (listener.v2)
+                    {
+                        listener.v2(capture.event);
+                    }
+                    else if (listener.v1)
+                    {
+                        listener.v1(capture.event.playerID, capture.event.isUnfair, capture.unfairCapsDisabled, capture.event.isSelfCap);
+                    }
+
+                    listener.delivered.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+
+            listener.pending.fetch_sub(1, std::memory_order_relaxed);
+            delivery.listener.reset();
+        }
+
+        if (!keepRunning)
+        {
+            break;
+        }
+
+        std::unique_lock<std::mutex> lock(worker.wakeLock);
+        worker.sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        // Producers that see `sleeping` notify under `wakeLock`, so the wakeup can't land between the check and the wait
+        worker.wake.wait(lock, [this, &worker]() {
+            return worker.queue.size() != 0 || !running.load(std::memory_order_acquire);
+        });
+
+        worker.sleeping.store(false, std::memory_order_relaxed);
+    }
+}
+
+void AsyncListenerPool::report(int playerID, const std::vector<std::shared_ptr<AsyncCaptureListener>> &listeners) const
+{
+    if (!isRunning())
+    {
+        return;
+    }
+
+    bz_sendTextMessagef(BZ_SERVER, playerID, "  %-8s %8s %10s %10s %10s", "async", "worker", "pending", "delivered", "dropped");
+
+    for (const auto &listener : listeners)
+    {
+        bz_sendTextMessagef(BZ_SERVER, playerID, "  #%-7d %8d %10llu %10llu %10llu", listener->handle, (int)(listener->handle % workers.size()),
+            (unsigned long long)listener->pending.load(std::memory_order_relaxed),
+            (unsigned long long)listener->delivered.load(std::memory_order_relaxed),
+            (unsigned long long)listener->dropped.load(std::memory_order_relaxed));
+    }
+
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        bz_sendTextMessagef(BZ_SERVER, playerID, "  worker %d queue: %llu of %llu, deepest %llu", (int)i,
+            (unsigned long long)workers[i]->queue.size(), (unsigned long long)workers[i]->queue.capacity(),
+            (unsigned long long)workers[i]->highWater.load(std::memory_order_relaxed));
+    }
+}
+
+void AsyncListenerPool::resetStats(const std::vector<std::shared_ptr<AsyncCaptureListener>> &listeners)
+{
+    // `pending` is left alone; it's what is still queued, not a count since the last reset
+    for (const auto &listener : listeners)
+    {
+        listener->delivered.store(0, std::memory_order_relaxed);
+        listener->dropped.store(0, std::memory_order_relaxed);
+    }
+
+    for (auto &worker : workers)
+    {
+        worker->highWater.store(0, std::memory_order_relaxed);
+    }
+}
+
+CaptureListenerRegistry::CaptureListenerRegistry() :
+    nextHandle(0),
+    dispatchDepth(0),
+    needsCompaction(false)
+{
+}
+
+int CaptureListenerRegistry::add(const OnCaptureEventCallbackV1 &callback, bool async)
+{
+    if (async)
+    {
+        std::shared_ptr<AsyncCaptureListener> listener = std::make_shared<AsyncCaptureListener>();
+        listener->v1 = callback;
+
+        return add(Listener{0, false, true, nullptr, nullptr, listener});
+    }
+
+    return add(Listener{0, false, true, callback, nullptr, nullptr});
+}
+
+int CaptureListenerRegistry::add(const OnCaptureEventCallbackV2 &callback, bool async)
+{
+    if (async)
+    {
+        std::shared_ptr<AsyncCaptureListener> listener = std::make_shared<AsyncCaptureListener>();
+        listener->v2 = callback;
+
+        return add(Listener{0, false, false, nullptr, nullptr, listener});
+    }
+
+    return add(Listener{0, false, false, nullptr, callback, nullptr});
+}
+
+int CaptureListenerRegistry::add(Listener &&listener)
+{
+    int handle = nextHandle++;
+    listener.handle = handle;
+
+    if (listener.async)
+    {
+        listener.async->handle = handle;
+        asyncPool.start();
+    }
+
+    if (dispatchDepth > 0)
+    {
+        pending.push_back(std::move(listener));
+    }
+    else
+    {
+        listeners.push_back(std::move(listener));
+    }
+
+    return handle;
+}
+
+bool CaptureListenerRegistry::remove(int handle)
+{
+    auto byHandle = [](const Listener &listener, int value) { return listener.handle < value; };
+
+    for (std::vector<Listener>* list : {&listeners, &pending})
+    {
+        auto it = std::lower_bound(list->begin(), list->end(), handle, byHandle);
+
+        if (it == list->end() || it->handle != handle || it->removed)
+        {
+            continue;
+        }
+
+        it->removed = true;
+        needsCompaction = true;
+
+        if (it->async)
+        {
+            asyncPool.retire(*it->async);
+        }
+
+        if (dispatchDepth == 0)
+        {
+            compact();
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+size_t CaptureListenerRegistry::dispatch(const CaptureDispatch &capture, size_t &queued, size_t &dropped)
+{
+    size_t invoked = 0;
+    queued = 0;
+    dropped = 0;
+
+    dispatchDepth++;
+
+    // Only the listeners registered before this dispatch started are invoked; new ones are waiting in `pending`
+    for (size_t i = 0; i < listeners.size(); i++)
+    {
+        const Listener &listener = listeners[i];
+
+        if (listener.removed || (listener.isV1 && !capture.notifyV1))
+        {
+            continue;
+        }
+
+        if (listener.async)
+        {
+            if (asyncPool.enqueue(listener.async, capture))
+            {
+                queued++;
+            }
+            else
+            {
+                dropped++;
+            }
+
+            continue;
+        }
+
+        TraceSpan span("listener", "listener");
+
+        const CaptureEventV2 &event = capture.event;
+
+        if (listener.v2)
+        {
+            listener.v2(event);
+        }
+        else
+        {
+            listener.v1(event.playerID, event.isUnfair, capture.unfairCapsDisabled, event.isSelfCap);
+        }
+
+        invoked++;
+    }
+
+    if (--dispatchDepth == 0)
+    {
+        compact();
+    }
+
+    return invoked;
+}
+
+void CaptureListenerRegistry::configureAsync(int threads, int queueSize)
+{
+    asyncPool.configure(threads, queueSize);
+}
+
+std::vector<std::shared_ptr<AsyncCaptureListener>> CaptureListenerRegistry::asyncListeners() const
+{
+    std::vector<std::shared_ptr<AsyncCaptureListener>> found;
+
+    for (const Listener &listener : listeners)
+    {
+        if (listener.async && !listener.removed)
+        {
+            found.push_back(listener.async);
+        }
+    }
+
+    return found;
+}
+
+void CaptureListenerRegistry::reportAsync(int playerID) const
+{
+    asyncPool.report(playerID, asyncListeners());
+}
+
+void CaptureListenerRegistry::resetAsyncStats()
+{
+    asyncPool.resetStats(asyncListeners());
+}
+
+void CaptureListenerRegistry::clear()
+{
+    // Deliver whatever is still queued before the callbacks go away
+    asyncPool.stop();
+
+    listeners.clear();
+    pending.clear();
+    needsCompaction = false;
+}
+
+void CaptureListenerRegistry::compact()
+{
+    if (needsCompaction)
+    {
+        listeners.erase(std::remove_if(listeners.begin(), listeners.end(), [](const Listener &l) { return l.removed; }), listeners.end());
+        pending.erase(std::remove_if(pending.begin(), pending.end(), [](const Listener &l) { return l.removed; }), pending.end());
+        needsCompaction = false;
+    }
+
+    if (!pending.empty())
+    {
+        std::move(pending.begin(), pending.end(), std::back_inserter(listeners));
+        pending.clear();
+    }
+}
+
+void TeamRoster::reset()
+{
+    playerTeam.fill(eNoTeam);
+    teamSize.fill(0);
+}
+
+bool TeamRoster::setPlayerTeam(int playerID, bz_eTeamType team)
+{
+    if (playerID < 0 || playerID >= MAX_PLAYER_SLOTS || playerTeam[playerID] == team)
+    {
+        return false;
+    }
+
+    bz_eTeamType previous = playerTeam[playerID];
+
+    if (0 <= previous && previous < TEAM_SLOTS)
+    {
+        teamSize[previous]--;
+    }
+
+    if (0 <= team && team < TEAM_SLOTS)
+    {
+        teamSize[team]++;
+    }
+
+    playerTeam[playerID] = team;
+
+    return true;
+}
+
+int TeamRoster::size(bz_eTeamType team) const
+{
+    return (0 <= team && team < TEAM_SLOTS) ? teamSize[team] : 0;
+}
+
+void DecayedTeamSizes::reset(const TeamRoster &roster, double now)
+{
+    for (int team = 0; team < TEAM_SLOTS; team++)
+    {
+        weighted[team] = target[team] = roster.teamSize[team];
+        since[team] = now;
+    }
+}
+
+void DecayedTeamSizes::setWindow(double seconds, const TeamRoster &roster, double now)
+{
+    if (seconds == window)
+    {
+        return;
+    }
+
+    // Time that has already passed is decayed with the old window; when decaying is turned on, it starts from the roster
+    if (window > 0)
+    {
+        for (int team = 0; team < TEAM_SLOTS; team++)
+        {
+            weighted[team] = size(team, now);
+            since[team] = now;
+        }
+    }
+    else
+    {
+        reset(roster, now);
+    }
+
+    window = seconds;
+}
+
+void DecayedTeamSizes::sync(const TeamRoster &roster, double now)
+{
+    for (int team = 0; team < TEAM_SLOTS; team++)
+    {
+        if (roster.teamSize[team] != target[team])
+        {
+            weighted[team] = size(team, now);
+            target[team] = roster.teamSize[team];
+            since[team] = now;
+        }
+    }
+}
+
+double DecayedTeamSizes::size(int team, double now) const
+{
+    if (window <= 0)
+    {
+        return target[team];
+    }
+
+    return target[team] + (weighted[team] - target[team]) * std::exp(-std::max(0.0, now - since[team]) / window);
+}
+
+void StateStore::reset()
+{
+    lastCapTime.fill(NEVER);
+    lastFlagDrop.fill(NEVER);
+
+    for (auto &row : capBonus)
+    {
+        row.fill(0);
+    }
+}
+
+TimerWheel::TimerWheel(double resolution, size_t slotCount) :
+    resolution(resolution),
+    slotMask(slotCount - 1),
+    currentTick(0),
+    slots(slotCount, -1)
+{
+}
+
+void TimerWheel::reset(double now)
+{
+    std::fill(slots.begin(), slots.end(), -1);
+
+    for (auto &timer : timers)
+    {
+        timer.active = false;
+    }
+
+    currentTick = (int64_t)std::floor(now / resolution);
+}
+
+int64_t TimerWheel::tickOf(double time) const
+{
+    // Round up so a timer never fires before its time, and never schedule into a tick that was already processed
+    return std::max(currentTick + 1, (int64_t)std::ceil(time / resolution));
+}
+
+void TimerWheel::schedule(int timerID, double when)
+{
+    if (timerID < 0)
+    {
+        return;
+    }
+
+    if ((size_t)timerID >= timers.size())
+    {
+        timers.resize(timerID + 1, Timer{0, -1, -1, false});
+        due.reserve(timers.size());
+    }
+
+    unlink(timerID);
+
+    timers[timerID].tick = tickOf(when);
+    link(timerID);
+}
+
+void TimerWheel::cancel(int timerID)
+{
+    if ((unsigned)timerID < timers.size())
+    {
+        unlink(timerID);
+    }
+}
+
+void TimerWheel::link(int timerID)
+{
+    Timer &timer = timers[timerID];
+    int &head = slots[timer.tick & slotMask];
+
+    timer.prev = -1;
+    timer.next = head;
+    timer.active = true;
+
+    if (head >= 0)
+    {
+        timers[head].prev = timerID;
+    }
+
+    head = timerID;
+}
+
+void TimerWheel::unlink(int timerID)
+{
+    Timer &timer = timers[timerID];
+
+    if (!timer.active)
+    {
+        return;
+    }
+
+    if (timer.prev >= 0)
+    {
+        timers[timer.prev].next = timer.next;
+    }
+    else
+    {
+        slots[timer.tick & slotMask] = timer.next;
+    }
+
+    if (timer.next >= 0)
+    {
+        timers[timer.next].prev = timer.prev;
+    }
+
+    timer.active = false;
+}
+
+TeamFlagTracker::TeamFlagTracker() :
+    timers(TICK_INTERVAL, FLAG_TIMER_SLOTS)
+{
+    states.fill(TeamFlagState::Available);
+    cooldownEnds.fill(NEVER);
+}
+
+void TeamFlagTracker::reset(double now)
+{
+    states.fill(TeamFlagState::Available);
+    cooldownEnds.fill(NEVER);
+    timers.reset(now);
+}
+
+void TeamFlagTracker::captured(bz_eTeamType team, double cooldownEndsAt, double now)
+{
+    cooldownEnds[team] = cooldownEndsAt;
+
+    if (cooldownEndsAt <= now)
+    {
+        states[team] = TeamFlagState::Available;
+        timers.cancel(team);
+
+        return;
+    }
+
+    states[team] = TeamFlagState::CoolingDown;
+    timers.schedule(team, cooldownEndsAt);
+}
+
+void TeamFlagTracker::grabbed(bz_eTeamType team)
+{
+    states[team] = TeamFlagState::Carried;
+    timers.cancel(team);
+}
+
+void TeamFlagTracker::dropped(bz_eTeamType team, double windowEndsAt, double now)
+{
+    // Enemies can't hold a flag that is cooling down, so this is a drop reported as part of the capture
+    if (states[team] == TeamFlagState::CoolingDown || windowEndsAt <= now)
+    {
+        return;
+    }
+
+    states[team] = TeamFlagState::DroppedRecently;
+    timers.schedule(team, windowEndsAt);
+}
+
+bool StateStore::writeSnapshot(const std::string &path, double now) const
+{
+    StateSnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+
+    header.magic = STATE_SNAPSHOT_MAGIC;
+    header.version = STATE_SNAPSHOT_VERSION;
+    header.headerSize = sizeof(StateSnapshotHeader);
+    header.teamSlots = TEAM_SLOTS;
+    header.savedServerTime = now;
+    header.savedWallTime = time(NULL);
+
+    for (int capped = 0; capped < TEAM_SLOTS; capped++)
+    {
+        header.lastCapTime[capped] = lastCapTime[capped];
+        header.lastFlagDrop[capped] = lastFlagDrop[capped];
+
+        for (int capping = 0; capping < TEAM_SLOTS; capping++)
+        {
+            header.capBonus[capping][capped] = capBonus[capping][capped];
+        }
+    }
+
+    // Write to a temporary file first so a crash mid-write never leaves a truncated snapshot behind
+    std::string tempPath = path + ".tmp";
+    FILE* file = fopen(tempPath.c_str(), "wb");
+
+    if (!file)
+    {
+        return false;
+    }
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+    written = (fclose(file) == 0) && written;
+
+#ifdef _WIN32
+    // rename() won't replace an existing file on Windows
+    if (written)
+    {
+        remove(path.c_str());
+    }
+#endif
+
+    // The last good snapshot is only replaced once the new one is completely written
+    if (!written || rename(tempPath.c_str(), path.c_str()) != 0)
+    {
+        remove(tempPath.c_str());
+
+        return false;
+    }
+
+    return true;
+}
+
+bool StateStore::restoreSnapshot(const std::vector<uint8_t> &snapshot, double now)
+{
+    if (snapshot.size() != sizeof(StateSnapshotHeader))
+    {
+        return false;
+    }
+
+    const StateSnapshotHeader* header = (const StateSnapshotHeader*)snapshot.data();
+
+    if (header->magic != STATE_SNAPSHOT_MAGIC || header->version != STATE_SNAPSHOT_VERSION ||
+        header->headerSize != sizeof(StateSnapshotHeader) || header->teamSlots != TEAM_SLOTS)
+    {
+        return false;
+    }
+
+    // Keep every timer the same age it was when it was saved, plus however long the server was down, so cooldowns
+    // and recalculation windows pick up where they left off. NEVER stays NEVER.
+    double downtime = std::max(0.0, (double)(time(NULL) - header->savedWallTime));
+    double offset = now - header->savedServerTime - downtime;
+
+    for (int capped = 0; capped < TEAM_SLOTS; capped++)
+    {
+        lastCapTime[capped] = header->lastCapTime[capped] + offset;
+        lastFlagDrop[capped] = header->lastFlagDrop[capped] + offset;
+
+        for (int capping = 0; capping < TEAM_SLOTS; capping++)
+        {
+            capBonus[capping][capped] = header->capBonus[capping][capped];
+        }
+    }
+
+    return true;
+}
+
+MessageCatalog::MessageCatalog() :
+    MessageCatalog(DEFAULT_LOCALE_NAME)
+{
+}
+
+MessageCatalog::MessageCatalog(const std::string &defaultLocale)
+{
+    addLocale(defaultLocale);
+
+    for (size_t i = 0; i < MESSAGE_COUNT; i++)
+    {
+        set(DEFAULT_LOCALE, (MessageID)i, MESSAGE_DEFINITIONS[i].fallback);
+    }
+}
+
+LocaleID MessageCatalog::addLocale(const std::string &name)
+{
+    localeNames.push_back(name);
+    entries.resize(entries.size() + MESSAGE_COUNT, Entry());
+
+    return (LocaleID)(localeNames.size() - 1);
+}
+
+void MessageCatalog::set(LocaleID locale, MessageID message, const std::string &raw)
+{
+    Entry &entry = entries[locale * MESSAGE_COUNT + (size_t)message];
+
+    entry = intern(raw);
+    entry.defined = true;
+}
+
+void MessageCatalog::finish()
+{
+    for (size_t locale = 1; locale < localeNames.size(); locale++)
+    {
+        for (size_t message = 0; message < MESSAGE_COUNT; message++)
+        {
+            if (!entries[locale * MESSAGE_COUNT + message].defined)
+            {
+                entries[locale * MESSAGE_COUNT + message] = entries[DEFAULT_LOCALE * MESSAGE_COUNT + message];
+                entries[locale * MESSAGE_COUNT + message].defined = false;
+            }
+        }
+    }
+
+    interned.clear();
+}
+
+size_t MessageCatalog::locales() const
+{
+    return localeNames.size();
+}
+
+const std::string& MessageCatalog::localeName(LocaleID locale) const
+{
+    return localeNames[locale];
+}
+
+LocaleID MessageCatalog::findLocale(const std::string &name) const
+{
+    for (size_t i = 0; i < localeNames.size(); i++)
+    {
+        if (localeNames[i] == name)
+        {
+            return (LocaleID)i;
+        }
+    }
+
+    return NO_LOCALE;
+}
+
+std::string MessageCatalog::raw(LocaleID locale, MessageID message) const
+{
+    const Entry &entry = entries[locale * MESSAGE_COUNT + (size_t)message];
+
+    return arena.substr(entry.source, entry.sourceLength);
+}
+
+size_t MessageCatalog::arenaSize() const
+{
+    return arena.size();
+}
+
+MessageCatalog::Entry MessageCatalog::intern(const std::string &raw)
+{
+    auto existing = interned.find(raw);
+
+    if (existing != interned.end())
+    {
+        return existing->second;
+    }
+
+    Entry entry;
+    entry.source = (uint32_t)arena.size();
+    entry.sourceLength = (uint32_t)raw.size();
+    entry.firstToken = (uint32_t)tokens.size();
+    entry.defined = false;
+
+    arena.append(raw);
+
+    size_t literalStart = 0;
+    size_t cursor = 0;
+
+    while ((cursor = raw.find('{', cursor)) != std::string::npos)
+    {
+        int match = -1;
+        size_t matchLength = 0;
+
+        for (size_t i = 0; i < (size_t)Placeholder::Count; i++)
+        {
+            size_t length = strlen(PLACEHOLDER_NAMES[i]);
+
+            if (raw.compare(cursor, length, PLACEHOLDER_NAMES[i]) == 0)
+            {
+                match = (int)i;
+                matchLength = length;
+                break;
+            }
+        }
+
+        // Unknown placeholders are left in the message as-is
+        if (match < 0)
+        {
+            cursor++;
+            continue;
+        }
+
+        if (cursor > literalStart)
+        {
+            tokens.push_back({-1, (uint32_t)(entry.source + literalStart), (uint32_t)(cursor - literalStart)});
+        }
+
+        tokens.push_back({match, 0, 0});
+
+        cursor += matchLength;
+        literalStart = cursor;
+    }
+
+    if (literalStart < raw.size())
+    {
+        tokens.push_back({-1, (uint32_t)(entry.source + literalStart), (uint32_t)(raw.size() - literalStart)});
+    }
+
+    entry.tokenCount = (uint32_t)tokens.size() - entry.firstToken;
+    interned[raw] = entry;
+
+    return entry;
+}
+
+void MessageCatalog::render(LocaleID locale, MessageID message, const PlaceholderValues &values, std::string &output) const
+{
+    const Entry &entry = entries[locale * MESSAGE_COUNT + (size_t)message];
+    const Token* token = tokens.data() + entry.firstToken;
+
+    output.clear();
+
+    for (uint32_t i = 0; i < entry.tokenCount; i++, token++)
+    {
+        if (token->placeholder < 0)
+        {
+            output.append(arena, token->offset, token->length);
+        }
+        else
+        {
+            output.append(values[token->placeholder]);
+        }
+    }
+}
+
+const char* CTFOverseer::Name()
+{
+    static const char* pluginBuild;
+
+    if (!pluginBuild)
+    {
+        pluginBuild = bz_format("%s %d.%d.%d (%d)", PLUGIN_NAME.c_str(), MAJOR, MINOR, REV, BUILD);
+    }
+
+    return pluginBuild;
+}
+
+void CTFOverseer::Init(const char* config)
+{
+    configFile = config;
+    tracer.nameThread("bzfs main");
+
+    memset(&scoreboard, 0, sizeof(scoreboard));
+    scoreboardDirty = true;
+
+    playerLocale.fill(NO_LOCALE);
+
+    for (auto &players : localePlayers)
+    {
+        players.clear();
+    }
+    roster.reset();
+
+    loadConfigurationFile();
+    initFunctionTable();
+
+    // Namespace our clip fields to avoid plug-in conflicts
+    bz_setclipFieldString("allejo/ctfOverseer", Name());
+
+    Register(bz_eAllowCTFCaptureEvent);
+    Register(bz_eAllowFlagGrab);
+    Register(bz_eCaptureEvent);
+    Register(bz_eFlagGrabbedEvent);
+    Register(bz_eFlagDroppedEvent);
+    Register(bz_ePlayerJoinEvent);
+    Register(bz_ePlayerPartEvent);
+    Register(bz_ePlayerSpawnEvent);
+    Register(bz_eWorldFinalized);
+    Register(bz_eBZDBChange);
+    Register(bz_eTickEvent);
+
+    MaxWaitTime = TICK_INTERVAL;
+
+    bz_registerCustomBZDBInt(bzdb_delayTeamFlagGrab, 20);
+    bz_registerCustomBZDBInt(bzdb_maxCapBonus, 9999);
+    bz_registerCustomBZDBBool(bzdb_disallowSelfCap, true);
+    bz_registerCustomBZDBBool(bzdb_disallowUnfairCap, false);
+    bz_registerCustomBZDBBool(bzdb_warnUnfairTeams, true);
+    bz_registerCustomBZDBDouble(bzdb_teamSizeDecayWindow, 0);
+
+    refreshBZDBSettings();
+
+    state.reset();
+    syncRoster();
+
+    loadStateSnapshot();
+    rebuildFlagStates();
+
+    bz_registerCustomSlashCommand("reload", this);
+    bz_registerCustomSlashCommand("ctfstats", this);
+    bz_registerCustomSlashCommand("ctftrace", this);
+    bz_registerCustomSlashCommand("ctflang", this);
+    bz_registerCustomSlashCommand("ctfplayer", this);
+    bz_registerCustomSlashCommand("ctftop", this);
+
+    reloader.start(configFile.c_str());
+}
+
+void CTFOverseer::Cleanup()
+{
+    Flush();
+
+    reloader.stop();
+    traceDump.stop();
+
+    bz_removeCustomBZDBVariable(bzdb_delayTeamFlagGrab);
+    bz_removeCustomBZDBVariable(bzdb_maxCapBonus);
+    bz_removeCustomBZDBVariable(bzdb_disallowSelfCap);
+    bz_removeCustomBZDBVariable(bzdb_disallowUnfairCap);
+    bz_removeCustomBZDBVariable(bzdb_warnUnfairTeams);
+    bz_removeCustomBZDBVariable(bzdb_teamSizeDecayWindow);
+
+    bz_removeCustomSlashCommand("reload");
+    bz_removeCustomSlashCommand("ctfstats");
+    bz_removeCustomSlashCommand("ctftrace");
+    bz_removeCustomSlashCommand("ctflang");
+    bz_removeCustomSlashCommand("ctfplayer");
+    bz_removeCustomSlashCommand("ctftop");
+
+    outbox.drain(outbox.size());
+
+    if (!settings->StateSnapshotFile.empty() && !state.writeSnapshot(settings->StateSnapshotFile, bz_getCurrentTime()))
+    {
+        logger.log(0, "ERROR :: CTF Overseer :: Could not write the state snapshot to: %s", settings->StateSnapshotFile.c_str());
+    }
+
+    captureListeners.clear();
+    captureLog.close();
+    playerStats.stop();
+    scoreboardOut.close();
+    logger.close();
+}
+
+void CTFOverseer::loadStateSnapshot()
+{
+    if (settings->StateSnapshotFile.empty())
+    {
+        return;
+    }
+
+    FILE* file = fopen(settings->StateSnapshotFile.c_str(), "rb");
+
+    if (!file)
+    {
+        return;
+    }
+
+    // The snapshot is the in-memory layout, so loading it is a single read
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    pendingSnapshot.resize(size > 0 ? size : 0);
+
+    if (pendingSnapshot.empty() || fread(pendingSnapshot.data(), pendingSnapshot.size(), 1, file) != 1)
+    {
+        pendingSnapshot.clear();
+    }
+
+    fclose(file);
+
+    // A snapshot describes a single shutdown; don't restore it again after a later crash
+    remove(settings->StateSnapshotFile.c_str());
+
+    // When loaded with -loadplugin the world doesn't exist yet, and bz_eWorldFinalized would wipe the restored state
+    if (bz_getNumFlags() > 0)
+    {
+        applyStateSnapshot();
+    }
+}
+
+void CTFOverseer::applyStateSnapshot()
+{
+    if (state.restoreSnapshot(pendingSnapshot, bz_getCurrentTime()))
+    {
+        logger.log(VERBOSE_DEBUG_LEVEL, "DEBUG :: CTF Overseer :: Restored state snapshot from: %s", settings->StateSnapshotFile.c_str());
+    }
+    else
+    {
+        logger.log(0, "WARNING :: CTF Overseer :: Ignoring an invalid or incompatible state snapshot: %s", settings->StateSnapshotFile.c_str());
+    }
+
+    pendingSnapshot.clear();
+    pendingSnapshot.shrink_to_fit();
+
+    rebuildFlagStates();
+    scoreboardDirty = true;
+}
+
+double CTFOverseer::flagCooldownRemaining(bz_eTeamType team, double now) const
+{
+    if (team < 0 || team >= TEAM_SLOTS || flags.state(team) != TeamFlagState::CoolingDown)
+    {
+        return 0;
+    }
+
+    return std::max(0.0, flags.cooldownEnd(team) - now);
+}
+
+void CTFOverseer::rebuildFlagStates()
+{
+    double now = bz_getCurrentTime();
+    std::array<bool, TEAM_SLOTS> carried;
+
+    for (int team = 0; team < TEAM_SLOTS; team++)
+    {
+        carried[team] = flags.state((bz_eTeamType)team) == TeamFlagState::Carried;
+    }
+
+    flags.reset(now);
+
+    for (int team = eRedTeam; team <= ePurpleTeam; team++)
+    {
+        bz_eTeamType flagTeam = (bz_eTeamType)team;
+        double cooldownEnd = state.lastCapTime[team] + bzdb.delayTeamFlagGrab;
+
+        if (bzdb.delayTeamFlagGrabEnabled && cooldownEnd > now)
+        {
+            flags.captured(flagTeam, cooldownEnd, now);
+        }
+        else if (carried[team])
+        {
+            flags.grabbed(flagTeam);
+        }
+        else
+        {
+            flags.dropped(flagTeam, state.lastFlagDrop[team] + RECALC_INTERVAL, now);
+        }
+    }
+}
+
+void CTFOverseer::syncRoster()
+{
+    roster.reset();
+
+    bz_APIIntList playerList;
+    bz_getPlayerIndexList(&playerList);
+
+    for (unsigned int i = 0; i < playerList.size(); i++)
+    {
+        roster.setPlayerTeam(playerList.get(i), bz_getPlayerTeam(playerList.get(i)));
+
+        // Players who were already here when the plug-in was loaded haven't picked a locale yet
+        setPlayerLocale(playerList.get(i), DEFAULT_LOCALE);
+        playerStats.setPlayer(playerList.get(i), bz_getPlayerCallsign(playerList.get(i)));
+    }
+
+    // Nothing is known about how long these players have been here, so the decayed sizes start at the current ones
+    decayedSizes.reset(roster, bz_getCurrentTime());
+
+    rebuildBonusMatrix();
+}
+
+void CTFOverseer::refreshBZDBSettings()
+{
+    int maxCapBonus = bz_getBZDBInt(bzdb_maxCapBonus);
+
+    if (maxCapBonus < 0)
+    {
+        logger.log(0, "WARNING :: CTF Overseer :: %s cannot be negative (%d), treating it as 0", bzdb_maxCapBonus, maxCapBonus);
+        maxCapBonus = 0;
+    }
+
+    bzdb.delayTeamFlagGrab = bz_getBZDBInt(bzdb_delayTeamFlagGrab);
+    bzdb.delayTeamFlagGrabEnabled = bzdb.delayTeamFlagGrab >= 0;
+    bzdb.maxCapBonus = maxCapBonus;
+    bzdb.disallowSelfCap = bz_getBZDBBool(bzdb_disallowSelfCap);
+    bzdb.disallowUnfairCap = bz_getBZDBBool(bzdb_disallowUnfairCap);
+    bzdb.warnUnfairTeams = bz_getBZDBBool(bzdb_warnUnfairTeams);
+
+    double decayWindow = bz_getBZDBDouble(bzdb_teamSizeDecayWindow);
+
+    if (!(decayWindow >= 0))
+    {
+        logger.log(0, "WARNING :: CTF Overseer :: %s cannot be negative (%f), treating it as 0", bzdb_teamSizeDecayWindow, decayWindow);
+        decayWindow = 0;
+    }
+
+    bzdb.teamSizeDecayWindow = decayWindow;
+    decayedSizes.setWindow(decayWindow, roster, bz_getCurrentTime());
+}
+
+void CTFOverseer::initFunctionTable()
+{
+    functionTable.size = sizeof(CTFOverseerAPIV1);
+    functionTable.version = CTFOVERSEER_API_V1;
+    functionTable.context = this;
+    functionTable.calcBonusPoints = &CTFOverseer::apiCalcBonusPoints;
+    functionTable.isFairCapture = &CTFOverseer::apiIsFairCapture;
+    functionTable.getTeamSizes = &CTFOverseer::apiGetTeamSizes;
+    functionTable.getBonusMatrix = &CTFOverseer::apiGetBonusMatrix;
+    functionTable.getFlagCooldowns = &CTFOverseer::apiGetFlagCooldowns;
+}
+
+int CTFOverseer::apiCalcBonusPoints(void* context, int teamCapping, int teamCapped)
+{
+    return static_cast<CTFOverseer*>(context)->calcCapturePoints((bz_eTeamType)teamCapping, (bz_eTeamType)teamCapped);
+}
+
+int CTFOverseer::apiIsFairCapture(void* context, int teamCapping, int teamCapped)
+{
+    return (int)static_cast<CTFOverseer*>(context)->isFairCapture((bz_eTeamType)teamCapping, (bz_eTeamType)teamCapped);
+}
+
+int CTFOverseer::apiGetTeamSizes(void* context, int* sizes, int count)
+{
+    CTFOverseer* plugin = static_cast<CTFOverseer*>(context);
+    int written = std::max(0, std::min(count, TEAM_SLOTS));
+
+    std::copy(plugin->roster.teamSize.begin(), plugin->roster.teamSize.begin() + written, sizes);
+
+    return written;
+}
+
+int CTFOverseer::apiGetBonusMatrix(void* context, int* matrix, int teams)
+{
+    CTFOverseer* plugin = static_cast<CTFOverseer*>(context);
+    int written = std::max(0, std::min(teams, TEAM_SLOTS));
+
+    for (int capping = 0; capping < written; capping++)
+    {
+        std::copy(plugin->bonusMatrix[capping].begin(), plugin->bonusMatrix[capping].begin() + written, matrix + capping * teams);
+    }
+
+    return written;
+}
+
+int CTFOverseer::apiGetFlagCooldowns(void* context, double* remaining, int count)
+{
+    CTFOverseer* plugin = static_cast<CTFOverseer*>(context);
+    int written = std::max(0, std::min(count, TEAM_SLOTS));
+    double now = bz_getCurrentTime();
+
+    for (int team = 0; team < written; team++)
+    {
+        remaining[team] = plugin->flagCooldownRemaining((bz_eTeamType)team, now);
+    }
+
+    return written;
+}
+
+int CTFOverseer::GeneralCallback(const char* name, void* data)
+{
+    if (!name)
+    {
+        return -9999;
+    }
+
+    ScopedLatency timer(stats, StatSection::CallbackUnknown);
+
+    if (strcmp(name, "calcBonusPoints") == 0)
+    {
+        timer.section = StatSection::CallbackCalcBonusPoints;
+        TeamPair* pair = static_cast<TeamPair*>(data);
+
+        return calcCapturePoints(pair->first, pair->second);
+    }
+    else if (strcmp(name, "isFairCapture") == 0)
+    {
+        timer.section = StatSection::CallbackIsFairCapture;
+        TeamPair* pair = static_cast<TeamPair*>(data);
+
+        return (int)isFairCapture(pair->first, pair->second);
+    }
+    else if (strcmp(name, "listenOnCaptureV1") == 0)
+    {
+        timer.section = StatSection::CallbackListenOnCapture;
+        OnCaptureEventCallbackV1* callback = static_cast<OnCaptureEventCallbackV1*>(data);
+
+        return captureListeners.add(*callback);
+    }
+    else if (strcmp(name, "listenOnCaptureV2") == 0)
+    {
+        timer.section = StatSection::CallbackListenOnCapture;
+        OnCaptureEventCallbackV2* callback = static_cast<OnCaptureEventCallbackV2*>(data);
+
+        return captureListeners.add(*callback);
+    }
+    else if (strcmp(name, "listenOnCaptureAsyncV1") == 0)
+    {
+        timer.section = StatSection::CallbackListenOnCapture;
+        OnCaptureEventCallbackV1* callback = static_cast<OnCaptureEventCallbackV1*>(data);
+
+        return captureListeners.add(*callback, true);
+    }
+    else if (strcmp(name, "listenOnCaptureAsyncV2") == 0)
+    {
+        timer.section = StatSection::CallbackListenOnCapture;
+        OnCaptureEventCallbackV2* callback = static_cast<OnCaptureEventCallbackV2*>(data);
+
+        return captureListeners.add(*callback, true);
+    }
+    else if (strcmp(name, "removeOnCapture") == 0)
+    {
+        timer.section = StatSection::CallbackRemoveOnCapture;
+        int* uid = static_cast<int*>(data);
+
+        return captureListeners.remove(*uid);
+    }
+    else if (strcmp(name, "getAPIV1") == 0)
+    {
+        timer.section = StatSection::CallbackGetAPI;
+        const CTFOverseerAPIV1** api = static_cast<const CTFOverseerAPIV1**>(data);
+
+        *api = &functionTable;
+
+        return CTFOVERSEER_API_V1;
+    }
+
+    return -9999;
+}
+
+void CTFOverseer::Event(bz_EventData* eventData)
+{
+    ScopedLatency timer(stats, StatSection::OtherEvent);
+
+    switch (eventData->eventType)
+    {
+        case bz_eAllowCTFCaptureEvent:
+        {
+            timer.section = StatSection::AllowCTFCapture;
+
+            bz_AllowCTFCaptureEventData_V1 *data = (bz_AllowCTFCaptureEventData_V1*)eventData;
+
+            if (data->teamCapped < 0 || data->teamCapped >= TEAM_SLOTS || data->teamCapping < 0 || data->teamCapping >= TEAM_SLOTS)
+            {
+                return;
+            }
+
+            bool isSelfCap = bz_getPlayerTeam(data->playerCapping) == data->teamCapped;
+            bool isUnfairCap = !isFairCapture(data->teamCapping, data->teamCapped);
+
+            CaptureDecision decision = decideCapture(isSelfCap, !isUnfairCap, bzdb.disallowSelfCap, bzdb.disallowUnfairCap);
+
+            if (decision == CaptureDecision::DeniedSelfCap)
+            {
+                data->allow = false;
+
+                stats.count(StatCounter::CaptureDeniedSelfCap);
+                playerStats.add(data->playerCapping, PlayerStat::DeniedCaptures);
+            }
+            else if (decision == CaptureDecision::DeniedUnfair)
+            {
+                data->allow = false;
+
+                stats.count(StatCounter::CaptureDeniedUnfair);
+                playerStats.add(data->playerCapping, PlayerStat::DeniedCaptures);
+
+                float safetyZone[3];
+                int playerID = data->playerCapping;
+                int flagID = bz_getPlayerFlagID(playerID);
+
+                if (bz_removePlayerFlag(playerID) && admitNotice(playerID, MessageClass::UnfairCaptureNotice))
+                {
+                    safeSendMessage(MessageID::UnfairCaptureNotice, playerID, MessageClass::UnfairCaptureNotice, placeholders);
+                }
+
+                bz_getNearestFlagSafetyZone(flagID, safetyZone);
+                bz_moveFlag(flagID, safetyZone);
+            }
+            else
+            {
+                stats.count(StatCounter::CaptureAllowed);
+            }
+
+            CaptureDispatch capture;
+            capture.notifyV1 = decision != CaptureDecision::DeniedSelfCap;
+            capture.unfairCapsDisabled = bzdb.disallowUnfairCap;
+
+            CaptureEventV2 &captureEvent = capture.event;
+            captureEvent.playerID = data->playerCapping;
+            captureEvent.teamCapping = data->teamCapping;
+            captureEvent.teamCapped = data->teamCapped;
+            captureEvent.cappingTeamSize = roster.size(data->teamCapping);
+            captureEvent.cappedTeamSize = roster.size(data->teamCapped);
+            captureEvent.points = capturePoints(data->teamCapping, data->teamCapped, isSelfCap, !isUnfairCap);
+            captureEvent.isUnfair = isUnfairCap;
+            captureEvent.wasDisallowed = !data->allow;
+            captureEvent.isSelfCap = isSelfCap;
+            captureEvent.eventTime = data->eventTime;
+            captureEvent.lastCapTime = state.lastCapTime[data->teamCapped];
+
+            size_t queued, dropped;
+
+            stats.count(StatCounter::ListenerInvocations, captureListeners.dispatch(capture, queued, dropped));
+            stats.count(StatCounter::AsyncListenerQueued, queued);
+            stats.count(StatCounter::AsyncListenerDropped, dropped);
+
+            recordCapture(CAPTURE_LOG_ALLOW_CAPTURE, data->playerCapping, data->teamCapping, data->teamCapped, captureEvent.points,
+                (isUnfairCap ? CAPTURE_LOG_UNFAIR : 0) | (isSelfCap ? CAPTURE_LOG_SELF_CAP : 0) | (data->allow ? 0 : CAPTURE_LOG_DISALLOWED));
+        }
+        break;
+
+        case bz_eAllowFlagGrab:
+        {
+            timer.section = StatSection::AllowFlagGrab;
+
+            bz_AllowFlagGrabData_V1* data = (bz_AllowFlagGrabData_V1*)eventData;
+
+            bz_eTeamType team = bzu_getTeamFromFlag(data->flagType);
+
+            // Don't disallow flag grabs of regular flags for any reason
+            if (!(eRedTeam <= team && team <= ePurpleTeam))
+            {
+                return;
+            }
+
+            // If the `_delayTeamFlagGrab` variable is set to a negative number, allow immediate flag grabs after capture
+            if (!bzdb.delayTeamFlagGrabEnabled)
+            {
+                stats.count(StatCounter::GrabAllowed);
+
+                return;
+            }
+
+            int playerID = data->playerID;
+
+            // Don't allow flag grabs on team flags that were captured less than `_delayTeamFlagGrab` seconds ago
+            if (flags.state(team) == TeamFlagState::CoolingDown && bz_getPlayerTeam(playerID) != team)
+            {
+                data->allow = false;
+
+                stats.count(StatCounter::GrabDeniedCooldown);
+                playerStats.add(playerID, PlayerStat::DeniedGrabs);
+
+                // Don't spam our users if they continue trying to grab it
+                if (admitNotice(playerID, MessageClass::CooldownNotice))
+                {
+                    placeholders[(size_t)Placeholder::TeamCapped].assign(bzu_GetTeamName(team));
+                    setNumberPlaceholder(Placeholder::GrabDelay, bzdb.delayTeamFlagGrab);
+                    setNumberPlaceholder(Placeholder::CooldownRemaining, (int)std::lround(flagCooldownRemaining(team, bz_getCurrentTime())));
+
+                    safeSendMessage(MessageID::CooldownNotice, playerID, MessageClass::CooldownNotice, placeholders);
+
+                    stats.count(StatCounter::CooldownWarningSent);
+                }
+            }
+            else
+            {
+                stats.count(StatCounter::GrabAllowed);
+            }
+        }
+        break;
+
+        case bz_eCaptureEvent:
+        {
+            timer.section = StatSection::Capture;
+
+            bz_CTFCaptureEventData_V1 *data = (bz_CTFCaptureEventData_V1*)eventData;
+
+            if (!(eRedTeam <= data->teamCapped && data->teamCapped <= ePurpleTeam) || data->teamCapping < 0 || data->teamCapping >= TEAM_SLOTS)
+            {
+                return;
+            }
+
+            double now = bz_getCurrentTime();
+
+            state.lastCapTime[data->teamCapped] = now;
+            flags.captured(data->teamCapped, bzdb.delayTeamFlagGrabEnabled ? now + bzdb.delayTeamFlagGrab : now, now);
+
+            scoreboard.captures[data->teamCapping]++;
+            scoreboardDirty = true;
+
+            placeholders[(size_t)Placeholder::Capper].assign(bz_getPlayerCallsign(data->playerCapping));
+            placeholders[(size_t)Placeholder::TeamCapping].assign(bzu_GetTeamName(data->teamCapping));
+            placeholders[(size_t)Placeholder::TeamCapped].assign(bzu_GetTeamName(data->teamCapped));
+
+            // A self-capture
+            if (data->teamCapped == bz_getPlayerTeam(data->playerCapping))
+            {
+                int penalty = -capturePoints(data->teamCapping, data->teamCapped, true, false);
+
+                bz_incrementPlayerLosses(data->playerCapping, penalty);
+
+                setPointsPlaceholders(-1 * penalty);
+                recordCapture(CAPTURE_LOG_CAPTURE, data->playerCapping, data->teamCapping, data->teamCapped, -1 * penalty, CAPTURE_LOG_SELF_CAP);
+                scoreboard.selfCaptures[data->teamCapping]++;
+                playerStats.add(data->playerCapping, PlayerStat::SelfCaptures);
+                playerStats.add(data->playerCapping, PlayerStat::PenaltyPoints, penalty);
+
+                safeSendMessage(MessageID::SelfCapturePublic, BZ_ALLUSERS, MessageClass::CaptureAnnouncement, placeholders);
+                safeSendMessage(MessageID::SelfCapturePrivate, data->playerCapping, MessageClass::CapturePrivate, placeholders);
+
+                return;
+            }
+
+            bool isFair = isFairCapture(data->teamCapping, data->teamCapped);
+            int bonusPoints = abs(capturePoints(data->teamCapping, data->teamCapped, false, isFair));
+
+            if (isFair)
+            {
+                bz_incrementPlayerWins(data->playerCapping, bonusPoints);
+
+                setPointsPlaceholders(bonusPoints);
+                recordCapture(CAPTURE_LOG_CAPTURE, data->playerCapping, data->teamCapping, data->teamCapped, bonusPoints, 0);
+                playerStats.add(data->playerCapping, PlayerStat::Captures);
+                playerStats.add(data->playerCapping, PlayerStat::BonusPoints, bonusPoints);
+
+                safeSendMessage(MessageID::FairCapturePublic, BZ_ALLUSERS, MessageClass::CaptureAnnouncement, placeholders);
+                safeSendMessage(MessageID::FairCapturePrivate, data->playerCapping, MessageClass::CapturePrivate, placeholders);
+            }
+            else
+            {
+                bz_incrementPlayerLosses(data->playerCapping, bonusPoints);
+
+                setPointsPlaceholders(-1 * bonusPoints);
+                recordCapture(CAPTURE_LOG_CAPTURE, data->playerCapping, data->teamCapping, data->teamCapped, -1 * bonusPoints, CAPTURE_LOG_UNFAIR);
+                scoreboard.unfairCaptures[data->teamCapping]++;
+                playerStats.add(data->playerCapping, PlayerStat::UnfairCaptures);
+                playerStats.add(data->playerCapping, PlayerStat::PenaltyPoints, bonusPoints);
+
+                safeSendMessage(MessageID::UnfairCapturePublic, BZ_ALLUSERS, MessageClass::CaptureAnnouncement, placeholders);
+                safeSendMessage(MessageID::UnfairCapturePrivate, data->playerCapping, MessageClass::CapturePrivate, placeholders);
+            }
+        }
+        break;
+
+        case bz_eFlagGrabbedEvent:
+        {
+            timer.section = StatSection::FlagGrabbed;
+
+            bz_FlagGrabbedEventData_V1 *data = (bz_FlagGrabbedEventData_V1*)eventData;
+
+            bz_eTeamType flagTeam = bzu_getTeamFromFlag(data->flagType);
+            bz_eTeamType grabTeam = bz_getPlayerTeam(data->playerID);
+
+            if (eRedTeam <= flagTeam && flagTeam <= ePurpleTeam && eRedTeam <= grabTeam && grabTeam <= ePurpleTeam && flagTeam != grabTeam)
+            {
+                // Only recalculate the capture bonus if it's been X seconds since the flag was last dropped.
+                // This is to prevent players from dropping the flag right before capture and triggering a
+                // recalculation. Team sizes decayed over at least that long barely move in that time, so they
+                // don't need this; a shorter window would let a drop pick up a team change almost immediately.
+                bool shouldRecalc = bzdb.teamSizeDecayWindow >= RECALC_INTERVAL || flags.state(flagTeam) != TeamFlagState::DroppedRecently;
+
+                flags.grabbed(flagTeam);
+
+                if (!shouldRecalc)
+                {
+                    return;
+                }
+
+                int flagTeamSize = scoringSize[flagTeam];
+                int grabTeamSize = scoringSize[grabTeam];
+
+                int capValue = bonusMatrix[grabTeam][flagTeam];
+
+                state.capBonus[grabTeam][flagTeam] = capValue;
+                scoreboardDirty = true;
+
+                bool sendWarning = bzdb.warnUnfairTeams;
+
+                if (sendWarning && capValue < 0 && flagTeamSize > 0 && admitNotice(data->playerID, MessageClass::UnfairTeamWarning))
+                {
+                    setNumberPlaceholder(Placeholder::TeamCappingSize, grabTeamSize);
+                    setNumberPlaceholder(Placeholder::TeamCappedSize, flagTeamSize);
+
+                    safeSendMessage(MessageID::UnfairTeamWarning, data->playerID, MessageClass::UnfairTeamWarning, placeholders);
+
+                    stats.count(StatCounter::UnfairTeamWarningSent);
+                }
+            }
+        }
+        break;
+
+        case bz_eFlagDroppedEvent:
+        {
+            timer.section = StatSection::FlagDropped;
+
+            bz_FlagDroppedEventData_V1 *data = (bz_FlagDroppedEventData_V1*)eventData;
+
+            bz_eTeamType flagTeam = bzu_getTeamFromFlag(data->flagType);
+            bz_eTeamType grabTeam = bz_getPlayerTeam(data->playerID);
+
+            // Only record the time of when an enemy drops the flag
+            if (eRedTeam <= flagTeam && flagTeam <= ePurpleTeam && flagTeam != grabTeam)
+            {
+                double now = bz_getCurrentTime();
+
+                state.lastFlagDrop[flagTeam] = now;
+                flags.dropped(flagTeam, now + RECALC_INTERVAL, now);
+            }
+        }
+        break;
+
+        case bz_ePlayerJoinEvent:
+        {
+            timer.section = StatSection::PlayerJoin;
+
+            bz_PlayerJoinPartEventData_V1 *data = (bz_PlayerJoinPartEventData_V1*)eventData;
+
+            setPlayerLocale(data->playerID, joinLocale(data->record));
+
+            if (data->record)
+            {
+                playerStats.setPlayer(data->playerID, data->record->callsign.c_str());
+            }
+
+            if (data->record && roster.setPlayerTeam(data->playerID, data->record->team))
+            {
+                rebuildBonusMatrix();
+            }
+        }
+        break;
+
+        case bz_ePlayerPartEvent:
+        {
+            timer.section = StatSection::PlayerPart;
+
+            bz_PlayerJoinPartEventData_V1 *data = (bz_PlayerJoinPartEventData_V1*)eventData;
+
+            notices.resetPlayer(data->playerID);
+            outbox.dropRecipient(data->playerID);
+            setPlayerLocale(data->playerID, NO_LOCALE);
+
+            // Anybody may take an unregistered callsign next, so only choices remembered by BZID outlive the player
+            if (data->record && data->record->bzID.empty() && !localePreferences.empty())
+            {
+                localePreferences.erase(localePreferenceKey(data->record));
+            }
+            playerStats.removePlayer(data->playerID);
+
+            if (roster.setPlayerTeam(data->playerID, eNoTeam))
+            {
+                rebuildBonusMatrix();
+            }
+        }
+        break;
+
+        case bz_ePlayerSpawnEvent:
+        {
+            timer.section = StatSection::PlayerSpawn;
+
+            bz_PlayerSpawnEventData_V1 *data = (bz_PlayerSpawnEventData_V1*)eventData;
+
+            // bzfs doesn't have a dedicated team change event, so catch players moved by other plug-ins when they spawn
+            if (roster.setPlayerTeam(data->playerID, data->team))
+            {
+                rebuildBonusMatrix();
+            }
+        }
+        break;
+
+        case bz_eWorldFinalized:
+        {
+            timer.section = StatSection::WorldFinalized;
+
+            state.reset();
+            rebuildFlagStates();
+            scoreboardDirty = true;
+
+            if (!pendingSnapshot.empty())
+            {
+                applyStateSnapshot();
+            }
+        }
+        break;
+
+        case bz_eTickEvent:
+        {
+            timer.section = StatSection::Tick;
+
+            applyPendingReload();
+            traceDump.reportFinished();
+
+            flags.advance(bz_getCurrentTime(), [this](bz_eTeamType team, TeamFlagState previous) {
+                if (previous != TeamFlagState::CoolingDown)
+                {
+                    return;
+                }
+
+                scoreboardDirty = true;
+
+                placeholders[(size_t)Placeholder::TeamCapped].assign(bzu_GetTeamName(team));
+                safeSendMessage(MessageID::FlagAvailablePublic, BZ_ALLUSERS, MessageClass::CaptureAnnouncement, placeholders);
+            });
+
+            if (bzdb.teamSizeDecayWindow > 0)
+            {
+                refreshDecayedBonusMatrix();
+            }
+
+            outbox.drain(settings->MessagesPerTick);
+            stats.count(StatCounter::QueuedMessageDropped, outbox.takeDropped());
+            playerStats.flush(bz_getCurrentTime());
+
+            if (scoreboardDirty && scoreboardOut.isOpen())
+            {
+                publishScoreboard();
+            }
+        }
+        break;
+
+        case bz_eBZDBChange:
+        {
+            timer.section = StatSection::BZDBChange;
+
+            bz_BZDBChangeData_V1 *data = (bz_BZDBChangeData_V1*)eventData;
+
+            bool isOurs = data->key == bzdb_delayTeamFlagGrab || data->key == bzdb_disallowSelfCap ||
+                data->key == bzdb_disallowUnfairCap || data->key == bzdb_maxCapBonus || data->key == bzdb_warnUnfairTeams ||
+                data->key == bzdb_teamSizeDecayWindow;
+
+            if (!isOurs)
+            {
+                return;
+            }
+
+            int previousMaxCapBonus = bzdb.maxCapBonus;
+            double previousDecayWindow = bzdb.teamSizeDecayWindow;
+
+            refreshBZDBSettings();
+            rebuildFlagStates();
+            scoreboardDirty = true;
+
+            if (bzdb.maxCapBonus != previousMaxCapBonus || bzdb.teamSizeDecayWindow != previousDecayWindow)
+            {
+                rebuildBonusMatrix();
+            }
+        }
+        break;
+
+        default:
+            break;
+    }
+}
+
+bool CTFOverseer::SlashCommand(int playerID, bz_ApiString command, bz_ApiString message, bz_APIStringList* params)
+{
+    if (command == "reload" && bz_hasPerm(playerID, "setAll"))
+    {
+        // The file is read on the reload thread; the result is applied and reported on the next tick
+        if (params->size() == 1 && params->get(0) == "ctfoverseer")
+        {
+            reloader.request(playerID, false);
+
+            return true;
+        }
+
+        if (params->size() == 0)
+        {
+            reloader.request(playerID, true);
+        }
+
+        return false;
+    }
+
+    if (command == "ctfstats")
+    {
+        if (!bz_hasPerm(playerID, "setAll"))
+        {
+            bz_sendTextMessagef(BZ_SERVER, playerID, "You do not have permission to run the /ctfstats command.");
+
+            return true;
+        }
+
+        if (params->size() == 1 && params->get(0) == "reset")
+        {
+            stats.reset();
+            captureListeners.resetAsyncStats();
+            bz_sendTextMessage(BZ_SERVER, playerID, "CTF Overseer stats reset");
+
+            return true;
+        }
+
+        stats.report(playerID);
+        captureListeners.reportAsync(playerID);
+
+        return true;
+    }
+
+    if (command == "ctftrace")
+    {
+        if (!bz_hasPerm(playerID, "setAll"))
+        {
+            bz_sendTextMessagef(BZ_SERVER, playerID, "You do not have permission to run the /ctftrace command.");
+
+            return true;
+        }
+
+        if (params->size() == 1 && (params->get(0) == "on" || params->get(0) == "off"))
+        {
+            tracer.setEnabled(params->get(0) == "on");
+            bz_sendTextMessagef(BZ_SERVER, playerID, "CTF Overseer tracing is %s", Tracer::enabled() ? "on" : "off");
+
+            return true;
+        }
+
+        if (params->size() >= 1 && params->size() <= 2 && params->get(0) == "dump")
+        {
+            double seconds = (params->size() == 2) ? atof(params->get(1).c_str()) : DEFAULT_TRACE_DUMP_SECONDS;
+
+            if (seconds <= 0)
+            {
+                bz_sendTextMessagef(BZ_SERVER, playerID, "Usage: /ctftrace dump [seconds]");
+
+                return true;
+            }
+
+            char fileName[64];
+            snprintf(fileName, sizeof(fileName), "/ctfOverseer-trace-%lld.json", (long long)time(NULL));
+
+            // The file is written in the background and the result is sent on a later tick
+            if (!traceDump.start(settings->TraceDir + fileName, seconds, playerID))
+            {
+                bz_sendTextMessagef(BZ_SERVER, playerID, "A trace is still being written, try again in a moment");
+            }
+
+            return true;
+        }
+
+        bz_sendTextMessagef(BZ_SERVER, playerID, "Usage: /ctftrace on|off|dump [seconds]");
+
+        return true;
+    }
+
+    if (command == "ctflang")
+    {
+        const MessageCatalog &catalog = settings->Messages;
+        std::string available;
+
+        for (size_t locale = 0; locale < catalog.locales(); locale++)
+        {
+            available += (locale == 0) ? "" : ", ";
+            available += catalog.localeName((LocaleID)locale);
+        }
+
+        if (params->size() == 0)
+        {
+            bz_sendTextMessagef(BZ_SERVER, playerID, "CTF Overseer messages are shown to you in \"%s\"", catalog.localeName(localeOf(playerID)).c_str());
+            bz_sendTextMessagef(BZ_SERVER, playerID, "Available languages: %s", available.c_str());
+
+            return true;
+        }
+
+        if (params->size() != 1)
+        {
+            bz_sendTextMessagef(BZ_SERVER, playerID, "Usage: /ctflang [language]");
+
+            return true;
+        }
+
+        LocaleID locale = catalog.findLocale(lowercase(params->get(0).c_str()));
+
+        if (locale == NO_LOCALE)
+        {
+            bz_sendTextMessagef(BZ_SERVER, playerID, "Unknown language \"%s\"; available languages: %s", params->get(0).c_str(), available.c_str());
+
+            return true;
+        }
+
+        setPlayerLocale(playerID, locale);
+
+        // Remembered so the choice is restored when the player rejoins
+        bz_BasePlayerRecord* record = bz_getPlayerByIndex(playerID);
+
+        if (record)
+        {
+            // Everybody starts with the default locale, so there's nothing to remember for it
+            if (locale == DEFAULT_LOCALE)
+            {
+                localePreferences.erase(localePreferenceKey(record));
+            }
+            else
+            {
+                localePreferences[localePreferenceKey(record)] = catalog.localeName(locale);
+            }
+
+            bz_freePlayerRecord(record);
+        }
+
+        bz_sendTextMessagef(BZ_SERVER, playerID, "CTF Overseer messages will be shown to you in \"%s\"", catalog.localeName(locale).c_str());
+
+        return true;
+    }
+
+    if (command == "ctfplayer" || command == "ctftop")
+    {
+        if (!playerStats.isOpen())
+        {
+            bz_sendTextMessage(BZ_SERVER, playerID, "Player stats are not being kept on this server");
+
+            return true;
+        }
+
+        if (command == "ctfplayer")
+        {
+            // Callsigns may contain spaces, so the whole argument is the callsign
+            std::string callsign = bz_trim(message.c_str(), " ");
+
+            if (callsign.empty())
+            {
+                const char* ownCallsign = bz_getPlayerCallsign(playerID);
+                callsign = ownCallsign ? ownCallsign : "";
+            }
+
+            PlayerStatRecord record;
+
+            if (!playerStats.lookup(callsign, record))
+            {
+                bz_sendTextMessage(BZ_SERVER, playerID, "Player stats are still being loaded, try again in a moment");
+            }
+            else if (record.callsign.empty())
+            {
+                bz_sendTextMessagef(BZ_SERVER, playerID, "There are no CTF stats for %s", callsign.c_str());
+            }
+            else
+            {
+                const auto &values = record.values;
+
+                bz_sendTextMessagef(BZ_SERVER, playerID, "CTF stats for %s: %lld caps, %lld unfair caps, %lld self caps; %lld caps and %lld flag grabs denied; +%lld / -%lld points",
+                    record.callsign.c_str(), (long long)values[(size_t)PlayerStat::Captures], (long long)values[(size_t)PlayerStat::UnfairCaptures],
+                    (long long)values[(size_t)PlayerStat::SelfCaptures], (long long)values[(size_t)PlayerStat::DeniedCaptures],
+                    (long long)values[(size_t)PlayerStat::DeniedGrabs], (long long)values[(size_t)PlayerStat::BonusPoints],
+                    (long long)values[(size_t)PlayerStat::PenaltyPoints]);
+            }
+
+            return true;
+        }
+
+        size_t stat = 0;
+
+        while (params->size() == 1 && stat < PLAYER_STATS && params->get(0) != PLAYER_STAT_NAMES[stat])
+        {
+            stat++;
+        }
+
+        if (params->size() > 1 || stat == PLAYER_STATS)
+        {
+            std::string names;
+
+            for (size_t i = 0; i < PLAYER_STATS; i++)
+            {
+                names += (i == 0) ? "" : "|";
+                names += PLAYER_STAT_NAMES[i];
+            }
+
+            bz_sendTextMessagef(BZ_SERVER, playerID, "Usage: /ctftop [%s]", names.c_str());
+
+            return true;
+        }
+
+        std::vector<PlayerStatRecord> records;
+
+        if (!playerStats.top((PlayerStat)stat, PLAYER_STATS_TOP_COUNT, records))
+        {
+            bz_sendTextMessage(BZ_SERVER, playerID, "Player stats are still being loaded, try again in a moment");
+
+            return true;
+        }
+
+        bz_sendTextMessagef(BZ_SERVER, playerID, "Top players by %s:", PLAYER_STAT_NAMES[stat]);
+
+        for (size_t i = 0; i < records.size(); i++)
+        {
+            bz_sendTextMessagef(BZ_SERVER, playerID, "  %u. %s - %lld", (unsigned)(i + 1), records[i].callsign.c_str(), (long long)records[i].values[stat]);
+        }
+
+        return true;
+    }
+
+    return false;
 }
 
-void CTFOverseer::Cleanup()
+void CTFOverseer::loadConfigurationFile()
 {
-    Flush();
+    TraceSpan span("loadConfigurationFile", "config");
+    std::string error;
 
-    bz_removeCustomBZDBVariable(bzdb_delayTeamFlagGrab);
-    bz_removeCustomBZDBVariable(bzdb_maxCapBonus);
-    bz_removeCustomBZDBVariable(bzdb_disallowSelfCap);
-    bz_removeCustomBZDBVariable(bzdb_disallowUnfairCap);
-    bz_removeCustomBZDBVariable(bzdb_warnUnfairTeams);
+    // There's no configuration to keep yet, so anything wrong with the file falls back to the defaults for just the parts
+    // that are wrong
+    std::shared_ptr<const Configuration> config = buildConfiguration(configFile.c_str(), false, error);
 
-    bz_removeCustomSlashCommand("reload");
+    if (!error.empty())
+    {
+        logger.log(0, "ERROR :: CTF Overseer :: Using defaults for the parts of the configuration file with errors: %s (%s)", configFile.c_str(), error.c_str());
+    }
+
+    applyConfiguration(config);
 }
 
-int CTFOverseer::GeneralCallback(const char* name, void* data)
+void CTFOverseer::applyConfiguration(const std::shared_ptr<const Configuration> &config)
 {
-    if (!name)
+    std::shared_ptr<const Configuration> previous = settings;
+    settings = config;
+
+    if (previous)
     {
-        return -9999;
+        remapPlayerLocales(previous->Messages);
     }
 
-    std::string callback = name;
+    reloader.setAutoReload(settings->AutoReload);
+    tracer.setEnabled(settings->TraceEnabled);
+    captureListeners.configureAsync(settings->AsyncListenerThreads, settings->AsyncListenerQueueSize);
 
-    if (callback == "calcBonusPoints")
+    for (size_t i = 0; i < NOTICE_CLASSES; i++)
     {
-        TeamPair* pair = static_cast<TeamPair*>(data);
-
-        return calcCapturePoints(pair->first, pair->second);
+        notices.configure((MessageClass)(FIRST_NOTICE_CLASS + i), settings->NoticeLimits[i]);
     }
-    else if (callback == "isFairCapture")
+
+    if (settings->CaptureLogDir != captureLog.directory())
     {
-        TeamPair* pair = static_cast<TeamPair*>(data);
+        captureLog.close();
 
-        return (int)isFairCapture(pair->first, pair->second);
+        if (!settings->CaptureLogDir.empty() && !captureLog.open(settings->CaptureLogDir, settings->CaptureLogSegmentRecords))
+        {
+            logger.log(0, "ERROR :: CTF Overseer :: Could not create a capture log segment in: %s", settings->CaptureLogDir.c_str());
+        }
     }
-    else if (callback == "listenOnCaptureV1")
-    {
-        OnCaptureEventCallbackV1* callback = static_cast<OnCaptureEventCallbackV1*>(data);
-        int uid = onCaptureEventListenersCounter++;
 
-        onCaptureEventListeners[uid] = *callback;
+    playerStats.setFlushInterval(settings->PlayerStatsFlushInterval);
 
-        return uid;
-    }
-    else if (callback == "removeOnCapture")
+    if (settings->PlayerStatsFile != playerStats.path())
     {
-        int* uid = static_cast<int*>(data);
+        playerStats.close();
 
-        return onCaptureEventListeners.erase(*uid) > 0;
+        if (!settings->PlayerStatsFile.empty())
+        {
+            playerStats.open(settings->PlayerStatsFile);
+        }
     }
 
-    return -9999;
-}
-
-void CTFOverseer::Event(bz_EventData* eventData)
-{
-    switch (eventData->eventType)
+    if (settings->ScoreboardName != scoreboardOut.name())
     {
-        case bz_eAllowCTFCaptureEvent:
+        scoreboardOut.close();
+
+        if (!settings->ScoreboardName.empty() && !scoreboardOut.open(settings->ScoreboardName))
         {
-            bz_AllowCTFCaptureEventData_V1 *data = (bz_AllowCTFCaptureEventData_V1*)eventData;
+            logger.log(0, "ERROR :: CTF Overseer :: Could not create the shared memory scoreboard: %s", settings->ScoreboardName.c_str());
+        }
 
-            bool areSelfCapsDisabled = bz_getBZDBBool(bzdb_disallowSelfCap);
-            bool isSelfCap = bz_getPlayerTeam(data->playerCapping) == data->teamCapped;
+        scoreboardDirty = true;
+    }
 
-            if (areSelfCapsDisabled && isSelfCap)
-            {
-                data->allow = false;
+    logger.setFileSink(settings->DebugLogFile, settings->DebugLogLevel);
 
-                return;
-            }
+    if (!logger.isEnabled(VERBOSE_DEBUG_LEVEL))
+    {
+        return;
+    }
 
-            bool areUnfairCapsDisabled = bz_getBZDBBool(bzdb_disallowUnfairCap);
-            bool isUnfairCap = !isFairCapture(data->teamCapping, data->teamCapped);
+    const ScoringPolicy &policy = settings->Scoring.policy();
+    const MessageCatalog &messages = settings->Messages;
 
-            if (areUnfairCapsDisabled && isUnfairCap)
-            {
-                data->allow = false;
+    logger.log(VERBOSE_DEBUG_LEVEL, "DEBUG :: CTF Overseer :: Loaded configuration...");
 
-                float safetyZone[3];
-                int playerID = data->playerCapping;
-                int flagID = bz_getPlayerFlagID(playerID);
+    for (size_t i = 0; i < MESSAGE_COUNT; i++)
+    {
+        logger.log(VERBOSE_DEBUG_LEVEL, "DEBUG :: CTF Overseer ::   %s: %s", MESSAGE_DEFINITIONS[i].key, messages.raw(DEFAULT_LOCALE, (MessageID)i).c_str());
+    }
 
-                if (bz_removePlayerFlag(playerID))
-                {
-                    bz_sendTextMessagef(BZ_SERVER, playerID, "Unfair flag captures are disabled, your flag has been taken.");
-                }
+    logger.log(VERBOSE_DEBUG_LEVEL, "DEBUG :: CTF Overseer ::   Locales: %u (%s is the default), %u bytes of message text",
+        (unsigned)messages.locales(), messages.localeName(DEFAULT_LOCALE).c_str(), (unsigned)messages.arenaSize());
+    logger.log(VERBOSE_DEBUG_LEVEL, "DEBUG :: CTF Overseer ::   Scoring: %d * losing + %d * (losing - capping), fair ratio %.2f, self cap x%d",
+        policy.losingTeamWeight, policy.teamDifferenceWeight, policy.fairRatio, policy.selfCapMultiplier);
+}
 
-                bz_getNearestFlagSafetyZone(flagID, safetyZone);
-                bz_moveFlag(flagID, safetyZone);
-            }
+void CTFOverseer::applyPendingReload()
+{
+    std::shared_ptr<const ConfigurationLoad> load = reloader.takeResult();
 
-            for (auto cb : onCaptureEventListeners)
-            {
-                cb.second(data->playerCapping, isUnfairCap, areUnfairCapsDisabled, isSelfCap);
-            }
-        }
-        break;
+    if (!load)
+    {
+        return;
+    }
 
-        case bz_eAllowFlagGrab:
+    if (!load->config)
+    {
+        logger.log(0, "ERROR :: CTF Overseer :: Keeping the current configuration, there was an error reading %s (%s)", configFile.c_str(), load->error.c_str());
+
+        if (load->requestedBy >= 0)
         {
-            bz_AllowFlagGrabData_V1* data = (bz_AllowFlagGrabData_V1*)eventData;
+            bz_sendTextMessagef(BZ_SERVER, load->requestedBy, "CTF Overseer was not reloaded: %s", load->error.c_str());
+        }
 
-            bz_eTeamType team = bzu_getTeamFromFlag(data->flagType);
+        return;
+    }
 
-            // Don't disallow flag grabs of regular flags for any reason
-            if (!(eRedTeam <= team && team <= ePurpleTeam))
-            {
-                return;
-            }
+    applyConfiguration(load->config);
+    rebuildBonusMatrix();
 
-            // If the team hasn't been capped against yet, don't disallow anything
-            if (!lastCapTime.count(team))
-            {
-                return;
-            }
+    if (load->requestedBy >= 0 && !load->quiet)
+    {
+        bz_sendTextMessage(BZ_SERVER, load->requestedBy, "CTF Overseer reloaded");
+    }
+}
 
-            int teamFlagGrabDelay = bz_getBZDBInt(bzdb_delayTeamFlagGrab);
-            double safeGrabTime = lastCapTime[team] + teamFlagGrabDelay;
+bool CTFOverseer::admitNotice(int playerID, MessageClass kind)
+{
+    if (notices.allow(playerID, kind, bz_getCurrentTime()))
+    {
+        return true;
+    }
 
-            // If the `_delayTeamFlagGrab` variable is set to a negative number, allow immediate flag grabs after capture
-            if (teamFlagGrabDelay < 0)
-            {
-                return;
-            }
+    static const StatCounter dropCounters[NOTICE_CLASSES] = {
+        StatCounter::CooldownWarningDropped,
+        StatCounter::UnfairTeamWarningDropped,
+        StatCounter::UnfairCaptureNoticeDropped,
+    };
 
-            int playerID = data->playerID;
+    stats.count(dropCounters[(size_t)kind - FIRST_NOTICE_CLASS]);
 
-            // Don't allow flag grabs on team flags that were captured less than `_delayTeamFlagGrab` seconds ago
-            if (bz_getCurrentTime() < safeGrabTime && bz_getPlayerTeam(data->playerID) != team)
-            {
-                data->allow = false;
+    return false;
+}
 
-                double safeMsgTime = lastFlagWarnMsg[playerID] + MESSAGE_SPAM_INTERVAL;
+void CTFOverseer::publishScoreboard()
+{
+    double now = bz_getCurrentTime();
 
-                // Don't spam our users if they continue trying to grab it
-                if (bz_getCurrentTime() > safeMsgTime)
-                {
-                    bz_sendTextMessagef(BZ_SERVER, playerID, "Team flags cannot be grabbed for %d seconds after they were last capped.", teamFlagGrabDelay);
-                    bz_sendTextMessagef(BZ_SERVER, playerID, "You cannot grab the %s team flag for another ~%.0f seconds", bzu_GetTeamName(team), (safeGrabTime - bz_getCurrentTime()));
+    scoreboard.wallTime = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+    scoreboard.serverTime = now;
 
-                    lastFlagWarnMsg[playerID] = bz_getCurrentTime();
-                }
-            }
-        }
-        break;
+    for (int team = 0; team < TEAM_SLOTS; team++)
+    {
+        scoreboard.teamSize[team] = roster.teamSize[team];
+        scoreboard.cooldownRemaining[team] = flagCooldownRemaining((bz_eTeamType)team, now);
 
-        case bz_eCaptureEvent:
+        for (int capped = 0; capped < TEAM_SLOTS; capped++)
         {
-            bz_CTFCaptureEventData_V1 *data = (bz_CTFCaptureEventData_V1*)eventData;
+            scoreboard.bonus[team][capped] = bonusMatrix[team][capped];
+            scoreboard.capBonus[team][capped] = state.capBonus[team][capped];
+        }
+    }
 
-            lastCapTime[data->teamCapped] = bz_getCurrentTime();
+    scoreboardOut.publish(scoreboard);
+    scoreboardDirty = false;
+}
 
-            StringDict placeholders;
-            placeholders["{capper}"] = bz_getPlayerCallsign(data->playerCapping);
-            placeholders["{teamCapping}"] = bzu_GetTeamName(data->teamCapping);
-            placeholders["{teamCapped}"] = bzu_GetTeamName(data->teamCapped);
+void CTFOverseer::safeSendMessage(MessageID message, int recipient, MessageClass kind, const PlaceholderValues &values)
+{
+    const MessageCatalog &catalog = settings->Messages;
 
-            // A self-capture
-            if (data->teamCapped == bz_getPlayerTeam(data->playerCapping))
-            {
-                int penalty = SELF_CAP_MULTIPLIER * bz_getTeamCount(data->teamCapped);
+    if (recipient != BZ_ALLUSERS)
+    {
+        LocaleID locale = localeOf(recipient);
 
-                bz_incrementPlayerLosses(data->playerCapping, penalty);
+        if (catalog.empty(locale, message))
+        {
+            return;
+        }
 
-                placeholders["{points}"] = std::to_string(-1 * penalty).c_str();
-                placeholders["{pointsAbs}"] = std::to_string(penalty).c_str();
+        TraceSpan span("safeSendMessage", "message");
 
-                safeSendMessage(settings.SelfCapturePublicMessage, BZ_ALLUSERS, placeholders);
-                safeSendMessage(settings.SelfCapturePrivateMessage, data->playerCapping, placeholders);
+        catalog.render(locale, message, values, outbox.enqueue(recipient, kind));
 
-                return;
-            }
+        return;
+    }
 
-            bool isFair = isFairCapture(data->teamCapping, data->teamCapped);
-            int bonusPoints = abs(capBonus[data->teamCapped]);
+    // While everybody shares a locale, a public message is still sent once to everybody
+    LocaleID onlyLocale = DEFAULT_LOCALE;
+    int localesInUse = 0;
 
-            if (isFair)
-            {
-                bz_incrementPlayerWins(data->playerCapping, bonusPoints);
+    for (size_t locale = 0; locale < catalog.locales(); locale++)
+    {
+        if (!localePlayers[locale].empty())
+        {
+            onlyLocale = (LocaleID)locale;
+            localesInUse++;
+        }
+    }
 
-                placeholders["{points}"] = placeholders["{pointsAbs}"] = std::to_string(bonusPoints).c_str();
+    if (localesInUse <= 1)
+    {
+        if (catalog.empty(onlyLocale, message))
+        {
+            return;
+        }
 
-                safeSendMessage(settings.FairCapturePublicMessage, BZ_ALLUSERS, placeholders);
-                safeSendMessage(settings.FairCapturePrivateMessage, data->playerCapping, placeholders);
-            }
-            else
-            {
-                bz_incrementPlayerLosses(data->playerCapping, bonusPoints);
+        TraceSpan span("safeSendMessage", "message");
 
-                placeholders["{points}"] = std::to_string(-1 * bonusPoints).c_str();
-                placeholders["{pointsAbs}"] = std::to_string(bonusPoints).c_str();
+        catalog.render(onlyLocale, message, values, outbox.enqueue(BZ_ALLUSERS, kind));
 
-                safeSendMessage(settings.UnfairCapturePublicMessage, BZ_ALLUSERS, placeholders);
-                safeSendMessage(settings.UnfairCapturePrivateMessage, data->playerCapping, placeholders);
-            }
+        return;
+    }
+
+    TraceSpan span("safeSendMessage", "message");
+
+    // Otherwise it's rendered once per locale and queued for each of its players. bzfs has no way to send one message to
+    // a list of players, so this costs a queue slot and a send per player, but all of the copies together only count
+    // once against `messages_per_tick`, like the single message they stand in for.
+    bool continuesBroadcast = false;
+
+    for (size_t locale = 0; locale < catalog.locales(); locale++)
+    {
+        if (localePlayers[locale].empty() || catalog.empty((LocaleID)locale, message))
+        {
+            continue;
         }
-        break;
 
-        case bz_eFlagGrabbedEvent:
+        catalog.render((LocaleID)locale, message, values, localizedText);
+
+        for (int playerID : localePlayers[locale])
         {
-            bz_FlagGrabbedEventData_V1 *data = (bz_FlagGrabbedEventData_V1*)eventData;
+            outbox.enqueue(playerID, kind, continuesBroadcast).assign(localizedText);
+            continuesBroadcast = true;
+        }
+    }
+}
 
-            bz_eTeamType flagTeam = bzu_getTeamFromFlag(data->flagType);
-            bz_eTeamType grabTeam = bz_getPlayerTeam(data->playerID);
+LocaleID CTFOverseer::localeOf(int playerID) const
+{
+    if (playerID < 0 || playerID >= MAX_PLAYER_SLOTS || playerLocale[playerID] == NO_LOCALE)
+    {
+        return DEFAULT_LOCALE;
+    }
 
-            if (eRedTeam <= grabTeam && grabTeam <= ePurpleTeam && flagTeam != grabTeam)
-            {
-                // Only recalculate the capture bonus if it's been X seconds since the flag was last dropped.
-                // This is to prevent players from dropping the flag right before capture and triggering a
-                // recalculation.
-                bool shouldRecalc = lastFlagDrop[data->flagID] + RECALC_INTERVAL < bz_getCurrentTime();
+    return playerLocale[playerID];
+}
 
-                // shouldRecalc will be false if the team flag has never been dropped before (the server
-                // just started), so allow a calculation on this occassion.
-                if (!lastFlagDrop.count(data->flagID) && !shouldRecalc)
-                {
-                    return;
-                }
+LocaleID CTFOverseer::joinLocale(const bz_BasePlayerRecord* record) const
+{
+    if (!record || localePreferences.empty())
+    {
+        return DEFAULT_LOCALE;
+    }
 
-                int flagTeamSize = bz_getTeamCount(flagTeam);
-                int grabTeamSize = bz_getTeamCount(grabTeam);
+    auto preference = localePreferences.find(localePreferenceKey(record));
 
-                int capValue = calcCapturePoints(grabTeam, flagTeam);
+    if (preference == localePreferences.end())
+    {
+        return DEFAULT_LOCALE;
+    }
 
-                capBonus[flagTeam] = capValue;
+    LocaleID locale = settings->Messages.findLocale(preference->second);
 
-                bool sendWarning = bz_getBZDBBool(bzdb_warnUnfairTeams);
+    return (locale == NO_LOCALE) ? DEFAULT_LOCALE : locale;
+}
 
-                if (sendWarning && capValue < 0 && flagTeamSize > 0)
-                {
-                    bz_sendTextMessagef(BZ_SERVER, data->playerID, "%d vs %d? Don't be a bad sport.", grabTeamSize, flagTeamSize);
-                }
-            }
-        }
-        break;
+void CTFOverseer::setPlayerLocale(int playerID, LocaleID locale)
+{
+    if (playerID < 0 || playerID >= MAX_PLAYER_SLOTS)
+    {
+        return;
+    }
 
-        case bz_eFlagDroppedEvent:
-        {
-            bz_FlagDroppedEventData_V1 *data = (bz_FlagDroppedEventData_V1*)eventData;
+    if (playerLocale[playerID] == locale)
+    {
+        return;
+    }
 
-            bz_eTeamType flagTeam = bzu_getTeamFromFlag(data->flagType);
-            bz_eTeamType grabTeam = bz_getPlayerTeam(data->playerID);
+    if (playerLocale[playerID] != NO_LOCALE)
+    {
+        std::vector<int> &players = localePlayers[playerLocale[playerID]];
+        auto found = std::find(players.begin(), players.end(), playerID);
 
-            // Only record the time of when an enemy drops the flag
-            if (eRedTeam <= flagTeam && flagTeam <= ePurpleTeam && flagTeam != grabTeam)
-            {
-                lastFlagDrop[data->flagID] = bz_getCurrentTime();
-            }
-        }
-        break;
+        *found = players.back();
+        players.pop_back();
+    }
 
-        default:
-            break;
+    playerLocale[playerID] = locale;
+
+    if (locale != NO_LOCALE)
+    {
+        localePlayers[locale].push_back(playerID);
     }
 }
 
-bool CTFOverseer::SlashCommand(int playerID, bz_ApiString command, bz_ApiString /*message*/, bz_APIStringList* params)
+void CTFOverseer::remapPlayerLocales(const MessageCatalog &previous)
 {
-    if (command == "reload" && bz_hasPerm(playerID, "setAll"))
+    // Locale IDs are only meaningful within one catalog, so players keep their locale by name across reloads
+    for (int playerID = 0; playerID < MAX_PLAYER_SLOTS; playerID++)
     {
-        if (params->size() == 1 && params->get(0) == "ctfoverseer")
+        if (playerLocale[playerID] == NO_LOCALE)
         {
-            loadConfigurationFile();
-            bz_sendTextMessage(BZ_SERVER, playerID, "CTF Overseer reloaded");
-
-            return true;
+            continue;
         }
 
-        if (params->size() == 0)
-        {
-            loadConfigurationFile();
-        }
+        LocaleID locale = settings->Messages.findLocale(previous.localeName(playerLocale[playerID]));
 
-        return false;
+        setPlayerLocale(playerID, (locale == NO_LOCALE) ? DEFAULT_LOCALE : locale);
     }
+}
 
-    return false;
+void CTFOverseer::setPointsPlaceholders(int points)
+{
+    char buffer[16];
+
+    snprintf(buffer, sizeof(buffer), "%d", points);
+    placeholders[(size_t)Placeholder::Points].assign(buffer);
+
+    snprintf(buffer, sizeof(buffer), "%d", abs(points));
+    placeholders[(size_t)Placeholder::PointsAbs].assign(buffer);
 }
 
-void CTFOverseer::loadConfigurationFile()
+void CTFOverseer::setNumberPlaceholder(Placeholder placeholder, int value)
 {
-    const char* section = "ctfOverseer";
-    PluginConfig plgCfg = PluginConfig(configFile.c_str());
+    char buffer[16];
 
-    if (plgCfg.errors)
+    snprintf(buffer, sizeof(buffer), "%d", value);
+    placeholders[(size_t)placeholder].assign(buffer);
+}
+
+void CTFOverseer::recordCapture(CaptureLogKind kind, int playerID, bz_eTeamType capping, bz_eTeamType capped, int points, uint8_t flags)
+{
+    if (!captureLog.isOpen())
     {
-        bz_debugMessagef(0, "ERROR :: CTF Overseer :: There was an error reading the configuration file: %s", configFile.c_str());
         return;
     }
 
-    settings.SelfCapturePublicMessage = bz_trim(plgCfg.item(section, "self_cap_message_pub").c_str(), "\"");
-    settings.SelfCapturePrivateMessage = bz_trim(plgCfg.item(section, "self_cap_message_pm").c_str(), "\"");
-    settings.FairCapturePublicMessage = bz_trim(plgCfg.item(section, "fair_cap_message_pub").c_str(), "\"");
-    settings.FairCapturePrivateMessage = bz_trim(plgCfg.item(section, "fair_cap_message_pm").c_str(), "\"");
-    settings.UnfairCapturePublicMessage = bz_trim(plgCfg.item(section, "unfair_cap_message_pub").c_str(), "\"");
-    settings.UnfairCapturePrivateMessage = bz_trim(plgCfg.item(section, "unfair_cap_message_pm").c_str(), "\"");
+    CaptureLogRecord record;
+    memset(&record, 0, sizeof(record));
+
+    record.serverTime = bz_getCurrentTime();
+    record.points = points;
+    record.kind = kind;
+    record.flags = flags;
+    record.teamCapping = capping;
+    record.teamCapped = capped;
+    record.cappingTeamSize = roster.size(capping);
+    record.cappedTeamSize = roster.size(capped);
+    record.playerID = playerID;
 
-    bz_debugMessagef(VERBOSE_DEBUG_LEVEL, "DEBUG :: CTF Overseer :: Loaded configuration...");
-    bz_debugMessagef(VERBOSE_DEBUG_LEVEL, "DEBUG :: CTF Overseer ::   Self cap public message: %s", settings.SelfCapturePublicMessage.c_str());
-    bz_debugMessagef(VERBOSE_DEBUG_LEVEL, "DEBUG :: CTF Overseer ::   Self cap private message: %s", settings.SelfCapturePrivateMessage.c_str());
-    bz_debugMessagef(VERBOSE_DEBUG_LEVEL, "DEBUG :: CTF Overseer ::   Fair cap public message: %s", settings.FairCapturePublicMessage.c_str());
-    bz_debugMessagef(VERBOSE_DEBUG_LEVEL, "DEBUG :: CTF Overseer ::   Fair cap private message: %s", settings.FairCapturePrivateMessage.c_str());
-    bz_debugMessagef(VERBOSE_DEBUG_LEVEL, "DEBUG :: CTF Overseer ::   Unfair cap public message: %s", settings.UnfairCapturePublicMessage.c_str());
-    bz_debugMessagef(VERBOSE_DEBUG_LEVEL, "DEBUG :: CTF Overseer ::   Unfair cap private message: %s", settings.UnfairCapturePrivateMessage.c_str());
+    captureLog.append(record);
 }
 
-void CTFOverseer::safeSendMessage(const std::string rawMsg, int recipient, StringDict placeholders)
+int CTFOverseer::capturePoints(bz_eTeamType capping, bz_eTeamType capped, bool isSelfCap, bool isFair)
 {
-    if (rawMsg == "")
-    {
-        return;
-    }
+    return awardedPoints(settings->Scoring.policy(), isSelfCap, isFair, state.capBonus[capping][capped], roster.size(capped));
+}
 
-    bz_ApiString msg = rawMsg;
-    formatString(msg, placeholders);
-    bz_sendTextMessage(BZ_SERVER, recipient, msg.c_str());
+bool CTFOverseer::isFairCapture(bz_eTeamType capping, bz_eTeamType capped)
+{
+    return isFairBonus(calcCapturePoints(capping, capped));
 }
 
-void CTFOverseer::formatString(bz_ApiString &string, StringDict placeholders)
+int CTFOverseer::calcCapturePoints(bz_eTeamType capping, bz_eTeamType capped)
 {
-    for (auto it : placeholders)
+    if (capping < 0 || capping >= TEAM_SLOTS || capped < 0 || capped >= TEAM_SLOTS)
     {
-        string.replaceAll(it.first.c_str(), it.second.c_str());
+        return 0;
     }
+
+    return bonusMatrix[capping][capped];
 }
 
-bool CTFOverseer::isFairCapture(bz_eTeamType capping, bz_eTeamType capped)
+/// The team size captures are scored with: the decayed size rounded to a whole player while `_teamSizeDecayWindow` is
+/// positive, otherwise the current one
+int CTFOverseer::scoringTeamSize(int team, double now) const
 {
-    return calcCapturePoints(capping, capped) > 0;
+    if (bzdb.teamSizeDecayWindow > 0)
+    {
+        int size = (int)std::lround(decayedSizes.size(team, now));
+
+        // A team that just got its first player would otherwise be worth no bonus, making a capture of it unfair
+        return (size < 1 && roster.teamSize[team] > 0) ? 1 : size;
+    }
+
+    return roster.teamSize[team];
 }
 
-int CTFOverseer::calcCapturePoints(bz_eTeamType capping, bz_eTeamType capped)
+void CTFOverseer::rebuildBonusMatrix()
 {
-    int losingTeamSize = bz_getTeamCount(capped);
-    int cappingTeamSize = bz_getTeamCount(capping);
+    scoreboardDirty = true;
 
-    bz_debugMessagef(VERBOSE_DEBUG_LEVEL, "DEBUG :: CTF Overseer :: Calculating bonus points for capping %s flag...", bzu_GetTeamName(capped));
-    bz_debugMessagef(VERBOSE_DEBUG_LEVEL, "DEBUG :: CTF Overseer ::   losing team   => %d", losingTeamSize);
-    bz_debugMessagef(VERBOSE_DEBUG_LEVEL, "DEBUG :: CTF Overseer ::   grabbing team => %d", cappingTeamSize);
+    double now = bz_getCurrentTime();
+    int maxCapBonus = bzdb.maxCapBonus;
 
-    if (cappingTeamSize == 0)
+    if (bzdb.teamSizeDecayWindow > 0)
     {
-        return 0;
+        decayedSizes.sync(roster, now);
     }
 
-    if (cappingTeamSize > losingTeamSize)
+    for (int team = 0; team < TEAM_SLOTS; team++)
     {
-        double ratio = (double)losingTeamSize / (double)cappingTeamSize;
+        scoringSize[team] = scoringTeamSize(team, now);
+    }
 
-        if (ratio <= 0.8)
+    for (int capping = 0; capping < TEAM_SLOTS; capping++)
+    {
+        for (int capped = 0; capped < TEAM_SLOTS; capped++)
         {
-            return 0;
+            bonusMatrix[capping][capped] = captureBonus(settings->Scoring, scoringSize[capping], scoringSize[capped], maxCapBonus);
         }
     }
 
-    int points = (3 * losingTeamSize + 8 * (losingTeamSize - cappingTeamSize));
+    if (!logger.isEnabled(VERBOSE_DEBUG_LEVEL))
+    {
+        return;
+    }
+
+    logger.log(VERBOSE_DEBUG_LEVEL, "DEBUG :: CTF Overseer :: Recalculated bonus points for team sizes...");
+
+    for (int team = eRedTeam; team <= ePurpleTeam; team++)
+    {
+        logger.log(VERBOSE_DEBUG_LEVEL, "DEBUG :: CTF Overseer ::   %s team => %d", bzu_GetTeamName((bz_eTeamType)team), scoringSize[team]);
+    }
+}
+
+void CTFOverseer::refreshDecayedBonusMatrix()
+{
+    double now = bz_getCurrentTime();
 
-    return std::min(bz_getBZDBInt(bzdb_maxCapBonus), points);
+    // Decayed sizes keep moving between roster changes, but the matrix only changes when one of them rounds differently
+    for (int team = 0; team < TEAM_SLOTS; team++)
+    {
+        if (scoringTeamSize(team, now) != scoringSize[team])
+        {
+            rebuildBonusMatrix();
+            return;
+        }
+    }
 }
@@ -2,6 +2,7 @@
 #define CTFOVERSEER_API_H
 
 #include <functional>
+#include <stdint.h>
 #include <utility>
 
 #include "bzfsAPI.h"
@@ -29,4 +30,103 @@ typedef std::pair<bz_eTeamType, bz_eTeamType> TeamPair;
  */
 typedef std::function<void(int playerID, bool isUnfair, bool wasDisallowed, bool isSelfCap)> OnCaptureEventCallbackV1;
 
+/**
+ * Everything CTF Overseer knows about a capture event, passed by reference to OnCaptureEventCallbackV2 listeners so they
+ * don't need to query bzfs for the same information.
+ *
+ * @since 1.2.0
+ */
+struct CaptureEventV2
+{
+    int playerID; /// The playerID of the player who triggered the capping event
+    bz_eTeamType teamCapping; /// The team of the player capturing the flag
+    bz_eTeamType teamCapped; /// The team whose flag was captured
+    int cappingTeamSize; /// The number of players on the capping team
+    int cappedTeamSize; /// The number of players on the team whose flag was captured
+    int points; /// The points the capture is worth to the capper; negative for penalties on self or unfair captures
+    bool isUnfair; /// Whether or not the capture event was considered unfair
+    bool wasDisallowed; /// Whether or not the capture event was disallowed because it was unfair or a self-capture
+    bool isSelfCap; /// Whether or not the capture event was triggered by a self-capture
+    double eventTime; /// The server time of the capture event
+    double lastCapTime; /// The server time `teamCapped` was previously captured on; negative infinity if it never was
+};
+
+/**
+ * Function signature used for the "on capture" callback registered through `listenOnCaptureV2`.
+ *
+ * The event is only valid for the duration of the call; copy anything that needs to be kept around.
+ *
+ * @since 1.2.0
+ */
+typedef std::function<void(const CaptureEventV2 &event)> OnCaptureEventCallbackV2;
+
+/**
+ * The version of the CTFOverseerAPIV1 function table exposed by this header.
+ *
+ * @since 1.2.0
+ */
+#define CTFOVERSEER_API_V1 1
+
+/**
+ * The number of team slots used by the batch queries in CTFOverseerAPIV1; teams are indexed by their bz_eTeamType value,
+ * from eRogueTeam through ePurpleTeam.
+ *
+ * @since 1.2.0
+ */
+#define CTFOVERSEER_TEAM_SLOTS 5
+
+extern "C"
+{
+    /**
+     * A C-ABI function table for querying CTF Overseer directly, without going through string-dispatched generic
+     * callbacks. Retrieve it once with `getCTFOverseerAPIV1()` and pass `context` as the first argument of every call.
+     *
+     * Fields are only ever appended; check that `size` covers the fields you use. The table is owned by CTF Overseer and
+     * is only valid while the plug-in is loaded, and its functions must only be called from the main bzfs thread.
+     *
+     * @since 1.2.0
+     */
+    typedef struct CTFOverseerAPIV1
+    {
+        uint32_t size; /// sizeof(CTFOverseerAPIV1) as compiled into CTF Overseer
+        uint32_t version; /// CTFOVERSEER_API_V1
+        void* context; /// Opaque pointer that must be passed back as the first argument of every function
+
+        /// The points that would be awarded at the given moment for a capture; same as the `calcBonusPoints` callback
+        int (*calcBonusPoints)(void* context, int teamCapping, int teamCapped);
+
+        /// 1 if the capture would be fair at the given moment, 0 otherwise; same as the `isFairCapture` callback
+        int (*isFairCapture)(void* context, int teamCapping, int teamCapped);
+
+        /// Writes up to `count` team sizes indexed by bz_eTeamType into `sizes`; returns the number written
+        int (*getTeamSizes)(void* context, int* sizes, int count);
+
+        /// Writes the `teams` x `teams` bonus matrix, row-major by [teamCapping][teamCapped], into `matrix`; returns the number of teams written
+        int (*getBonusMatrix)(void* context, int* matrix, int teams);
+
+        /// Writes the seconds remaining before each team flag may be grabbed by enemies (0 when grabbable) into `remaining`; returns the number written
+        int (*getFlagCooldowns)(void* context, double* remaining, int count);
+    } CTFOverseerAPIV1;
+}
+
+/**
+ * Look up CTF Overseer through the `allejo/ctfOverseer` clip field and fetch its function table.
+ *
+ * @return The function table or NULL if CTF Overseer is not loaded
+ *
+ * @since 1.2.0
+ */
+inline const CTFOverseerAPIV1* getCTFOverseerAPIV1()
+{
+    const char* pluginName = bz_getclipFieldString("allejo/ctfOverseer");
+    const CTFOverseerAPIV1* api = NULL;
+
+    if (pluginName != NULL && bz_pluginExists(pluginName))
+    {
+        bz_callPluginGenericCallback(pluginName, "getAPIV1", static_cast<void*>(&api));
+    }
+
+    return api;
+}
+
 #endif
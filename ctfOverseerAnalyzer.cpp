@@ -0,0 +1,422 @@
+/*
+ * Copyright (C) 2019 Vladimir "allejo" Jimenez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Summarizes the capture history written by the plug-in's `capture_log_dir` option. Segments are memory mapped and
+// split between worker threads, then the per-thread totals are merged.
+//
+// Usage: ctfOverseerAnalyzer [-j threads] <segment file or directory>...
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <limits>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ctfOverseerCaptureLog.h"
+
+const int TEAM_SLOTS = 8; /// Enough slots for every bz_eTeamType value a record may hold
+const char* const TEAM_NAMES[TEAM_SLOTS] = {"Rogue", "Red", "Green", "Blue", "Purple", "Rabbit", "Hunter", "Observer"};
+
+/// Captures that happened with the same difference between the capping and capped team sizes
+struct ImbalanceBucket
+{
+    uint64_t captures = 0;
+    uint64_t unfair = 0;
+    int64_t points = 0;
+};
+
+struct Summary
+{
+    uint64_t segments = 0;
+    uint64_t badSegments = 0;
+    uint64_t records = 0;
+
+    uint64_t attempts = 0;
+    uint64_t deniedSelfCaps = 0;
+    uint64_t deniedUnfairCaps = 0;
+
+    uint64_t captures = 0;
+    uint64_t fairCaptures = 0;
+    uint64_t unfairCaptures = 0;
+    uint64_t selfCaptures = 0;
+    int64_t pointsAwarded = 0;
+    int64_t pointsTaken = 0;
+
+    uint64_t capturesByTeam[TEAM_SLOTS] = {};
+    std::map<int, uint64_t> pointsHistogram;
+    std::map<int, ImbalanceBucket> imbalance; /// Keyed by capping team size - capped team size
+
+    double firstWallTime = std::numeric_limits<double>::infinity();
+    double lastWallTime = -std::numeric_limits<double>::infinity();
+
+    void add(const CaptureLogRecord &record, double wallTime);
+    void merge(const Summary &other);
+};
+
+void Summary::add(const CaptureLogRecord &record, double wallTime)
+{
+    records++;
+
+    firstWallTime = std::min(firstWallTime, wallTime);
+    lastWallTime = std::max(lastWallTime, wallTime);
+
+    if (record.kind == CAPTURE_LOG_ALLOW_CAPTURE)
+    {
+        attempts++;
+
+        if (record.flags & CAPTURE_LOG_DISALLOWED)
+        {
+            if (record.flags & CAPTURE_LOG_SELF_CAP)
+            {
+                deniedSelfCaps++;
+            }
+            else
+            {
+                deniedUnfairCaps++;
+            }
+        }
+
+        return;
+    }
+
+    if (record.kind != CAPTURE_LOG_CAPTURE)
+    {
+        return;
+    }
+
+    captures++;
+
+    if (record.flags & CAPTURE_LOG_SELF_CAP)
+    {
+        selfCaptures++;
+    }
+    else if (record.flags & CAPTURE_LOG_UNFAIR)
+    {
+        unfairCaptures++;
+    }
+    else
+    {
+        fairCaptures++;
+    }
+
+    if (record.points >= 0)
+    {
+        pointsAwarded += record.points;
+    }
+    else
+    {
+        pointsTaken -= record.points;
+    }
+
+    if (0 <= record.teamCapping && record.teamCapping < TEAM_SLOTS)
+    {
+        capturesByTeam[(int)record.teamCapping]++;
+    }
+
+    pointsHistogram[record.points]++;
+
+    if (!(record.flags & CAPTURE_LOG_SELF_CAP))
+    {
+        ImbalanceBucket &bucket = imbalance[(int)record.cappingTeamSize - (int)record.cappedTeamSize];
+        bucket.captures++;
+        bucket.unfair += (record.flags & CAPTURE_LOG_UNFAIR) ? 1 : 0;
+        bucket.points += record.points;
+    }
+}
+
+void Summary::merge(const Summary &other)
+{
+    segments += other.segments;
+    badSegments += other.badSegments;
+    records += other.records;
+
+    attempts += other.attempts;
+    deniedSelfCaps += other.deniedSelfCaps;
+    deniedUnfairCaps += other.deniedUnfairCaps;
+
+    captures += other.captures;
+    fairCaptures += other.fairCaptures;
+    unfairCaptures += other.unfairCaptures;
+    selfCaptures += other.selfCaptures;
+    pointsAwarded += other.pointsAwarded;
+    pointsTaken += other.pointsTaken;
+
+    for (int i = 0; i < TEAM_SLOTS; i++)
+    {
+        capturesByTeam[i] += other.capturesByTeam[i];
+    }
+
+    for (const auto &entry : other.pointsHistogram)
+    {
+        pointsHistogram[entry.first] += entry.second;
+    }
+
+    for (const auto &entry : other.imbalance)
+    {
+        ImbalanceBucket &bucket = imbalance[entry.first];
+        bucket.captures += entry.second.captures;
+        bucket.unfair += entry.second.unfair;
+        bucket.points += entry.second.points;
+    }
+
+    firstWallTime = std::min(firstWallTime, other.firstWallTime);
+    lastWallTime = std::max(lastWallTime, other.lastWallTime);
+}
+
+static bool hasExtension(const std::string &path, const char* extension)
+{
+    size_t length = strlen(extension);
+
+    return path.size() > length && path.compare(path.size() - length, length, extension) == 0;
+}
+
+static void collectSegments(const std::string &path, std::vector<std::string> &segments)
+{
+    struct stat info;
+
+    if (stat(path.c_str(), &info) != 0)
+    {
+        fprintf(stderr, "warning: cannot read %s\n", path.c_str());
+        return;
+    }
+
+    if (!S_ISDIR(info.st_mode))
+    {
+        segments.push_back(path);
+        return;
+    }
+
+    DIR* dir = opendir(path.c_str());
+
+    if (!dir)
+    {
+        fprintf(stderr, "warning: cannot list %s\n", path.c_str());
+        return;
+    }
+
+    while (struct dirent* entry = readdir(dir))
+    {
+        if (hasExtension(entry->d_name, CAPTURE_LOG_EXTENSION))
+        {
+            segments.push_back(path + "/" + entry->d_name);
+        }
+    }
+
+    closedir(dir);
+}
+
+static void analyzeSegment(const std::string &path, Summary &summary)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat info;
+
+    if (fd < 0 || fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(CaptureLogHeader))
+    {
+        fprintf(stderr, "warning: %s is not a capture log segment\n", path.c_str());
+        summary.badSegments++;
+
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+
+        return;
+    }
+
+    size_t size = info.st_size;
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED)
+    {
+        fprintf(stderr, "warning: cannot map %s\n", path.c_str());
+        summary.badSegments++;
+        return;
+    }
+
+    const CaptureLogHeader* header = (const CaptureLogHeader*)mapping;
+
+    if (header->magic != CAPTURE_LOG_MAGIC || header->version != CAPTURE_LOG_VERSION || header->recordSize != sizeof(CaptureLogRecord))
+    {
+        fprintf(stderr, "warning: %s has an unsupported header\n", path.c_str());
+        summary.badSegments++;
+        munmap(mapping, size);
+        return;
+    }
+
+    // The plug-in may still be appending to this segment; only trust records it has published
+    uint64_t count = header->recordCount;
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    count = std::min<uint64_t>(count, (size - sizeof(CaptureLogHeader)) / sizeof(CaptureLogRecord));
+
+    const CaptureLogRecord* records = (const CaptureLogRecord*)(header + 1);
+
+    for (uint64_t i = 0; i < count; i++)
+    {
+        double wallTime = header->createdWallTime + (records[i].serverTime - header->createdServerTime);
+        summary.add(records[i], wallTime);
+    }
+
+    summary.segments++;
+    munmap(mapping, size);
+}
+
+static void formatTime(double wallTime, char* buffer, size_t size)
+{
+    time_t seconds = (time_t)wallTime;
+    struct tm parts;
+
+    if (gmtime_r(&seconds, &parts))
+    {
+        strftime(buffer, size, "%Y-%m-%d %H:%M:%S UTC", &parts);
+    }
+    else
+    {
+        snprintf(buffer, size, "?");
+    }
+}
+
+static double percent(uint64_t part, uint64_t whole)
+{
+    return whole ? 100.0 * part / whole : 0.0;
+}
+
+static void report(const Summary &summary)
+{
+    printf("Segments:              %llu (%llu skipped)\n", (unsigned long long)summary.segments, (unsigned long long)summary.badSegments);
+    printf("Records:               %llu\n", (unsigned long long)summary.records);
+
+    if (summary.records == 0)
+    {
+        return;
+    }
+
+    char first[64], last[64];
+    formatTime(summary.firstWallTime, first, sizeof(first));
+    formatTime(summary.lastWallTime, last, sizeof(last));
+
+    printf("Time span:             %s - %s\n", first, last);
+    printf("\n");
+    printf("Capture attempts:      %llu\n", (unsigned long long)summary.attempts);
+    printf("  Denied self caps:    %llu\n", (unsigned long long)summary.deniedSelfCaps);
+    printf("  Denied unfair caps:  %llu\n", (unsigned long long)summary.deniedUnfairCaps);
+    printf("Captures:              %llu\n", (unsigned long long)summary.captures);
+    printf("  Fair:                %llu (%.1f%%)\n", (unsigned long long)summary.fairCaptures, percent(summary.fairCaptures, summary.captures));
+    printf("  Unfair:              %llu (%.1f%%)\n", (unsigned long long)summary.unfairCaptures, percent(summary.unfairCaptures, summary.captures));
+    printf("  Self:                %llu (%.1f%%)\n", (unsigned long long)summary.selfCaptures, percent(summary.selfCaptures, summary.captures));
+    printf("Points awarded:        %lld\n", (long long)summary.pointsAwarded);
+    printf("Points taken:          %lld\n", (long long)summary.pointsTaken);
+
+    printf("\nCaptures by team\n");
+
+    for (int i = 0; i < TEAM_SLOTS; i++)
+    {
+        if (summary.capturesByTeam[i])
+        {
+            printf("  %-10s %10llu\n", TEAM_NAMES[i], (unsigned long long)summary.capturesByTeam[i]);
+        }
+    }
+
+    printf("\nTeam size difference (capping - capped)\n");
+    printf("  %10s %10s %10s %12s\n", "difference", "captures", "unfair", "avg points");
+
+    for (const auto &entry : summary.imbalance)
+    {
+        const ImbalanceBucket &bucket = entry.second;
+
+        printf("  %+10d %10llu %9.1f%% %12.1f\n", entry.first, (unsigned long long)bucket.captures, percent(bucket.unfair, bucket.captures),
+            bucket.captures ? (double)bucket.points / bucket.captures : 0.0);
+    }
+
+    printf("\nPoints per capture\n");
+
+    for (const auto &entry : summary.pointsHistogram)
+    {
+        printf("  %+10d %10llu\n", entry.first, (unsigned long long)entry.second);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::string> segments;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+        {
+            threads = std::max(1, atoi(argv[++i]));
+        }
+        else
+        {
+            collectSegments(argv[i], segments);
+        }
+    }
+
+    if (segments.empty())
+    {
+        fprintf(stderr, "usage: %s [-j threads] <segment file or directory>...\n", argv[0]);
+        return 1;
+    }
+
+    threads = std::min<unsigned>(threads, segments.size());
+
+    // Segments are handed out one at a time so a few large files don't leave the other workers idle
+    std::atomic<size_t> next(0);
+    std::vector<Summary> partials(threads);
+    std::vector<std::thread> workers;
+
+    for (unsigned t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&, t]() {
+            for (size_t i = next++; i < segments.size(); i = next++)
+            {
+                analyzeSegment(segments[i], partials[t]);
+            }
+        });
+    }
+
+    Summary total;
+
+    for (unsigned t = 0; t < threads; t++)
+    {
+        workers[t].join();
+        total.merge(partials[t]);
+    }
+
+    report(total);
+
+    return 0;
+}
@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2019 Vladimir "allejo" Jimenez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Offline microbenchmarks for CTF Overseer's event handlers, driven by the stand-in bzfs API in ctfOverseerStubs.cpp.
+//
+// Usage: ctfOverseerBenchmark [config file] [iterations]
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "ctfOverseerStubs.h"
+
+#include "bzfsAPI.h"
+
+extern "C" bz_Plugin* bz_GetPlugin(void);
+extern "C" void bz_FreePlugin(bz_Plugin* plugin);
+
+static std::atomic<uint64_t> allocations(0);
+
+void* operator new(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+
+    if (void* ptr = malloc(size ? size : 1))
+    {
+        return ptr;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+struct Scenario
+{
+    const char* name;
+    std::vector<int> teamSizes; /// Red, green, blue and purple team sizes
+};
+
+struct Result
+{
+    double nsPerEvent;
+    double allocationsPerEvent;
+};
+
+static Result measure(int iterations, const std::function<void(int)> &body)
+{
+    // Warm up so reused buffers have already grown to their steady-state size
+    for (int i = 0; i < iterations / 10 + 1; i++)
+    {
+        body(i);
+    }
+
+    uint64_t allocationsBefore = allocations.load();
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < iterations; i++)
+    {
+        body(i);
+    }
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    uint64_t allocationsAfter = allocations.load();
+
+    Result result;
+    result.nsPerEvent = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+    result.allocationsPerEvent = (double)(allocationsAfter - allocationsBefore) / iterations;
+
+    return result;
+}
+
+static void report(const Scenario &scenario, const char* eventName, const Result &result)
+{
+    printf("%-14s %-20s %12.1f %14.2f\n", scenario.name, eventName, result.nsPerEvent, result.allocationsPerEvent);
+}
+
+static void runScenario(const Scenario &scenario, const char* configFile, int iterations)
+{
+    bzfsStub::reset();
+
+    std::vector<int> flagIDs;
+    std::vector<int> firstPlayer;
+    const char* flagTypes[] = {"R*", "G*", "B*", "P*"};
+    const bz_eTeamType teams[] = {eRedTeam, eGreenTeam, eBlueTeam, ePurpleTeam};
+
+    for (size_t t = 0; t < scenario.teamSizes.size(); t++)
+    {
+        flagIDs.push_back(bzfsStub::addFlag(flagTypes[t]));
+        firstPlayer.push_back(-1);
+
+        for (int p = 0; p < scenario.teamSizes[t]; p++)
+        {
+            int playerID = bzfsStub::addPlayer(teams[t], ("player" + std::to_string(t) + "-" + std::to_string(p)).c_str());
+
+            if (firstPlayer[t] < 0)
+            {
+                firstPlayer[t] = playerID;
+            }
+        }
+    }
+
+    // A regular flag to benchmark the early-out paths as well
+    int regularFlag = bzfsStub::addFlag("SW");
+
+    bz_Plugin* plugin = bz_GetPlugin();
+    bzfsStub::setActivePlugin(plugin);
+    plugin->Init(configFile);
+
+    int capper = firstPlayer[0];
+    int enemy = firstPlayer[1];
+
+    report(scenario, "AllowCTFCapture", measure(iterations, [&](int) {
+        bz_AllowCTFCaptureEventData_V1 data;
+        data.playerCapping = capper;
+        data.teamCapping = eRedTeam;
+        data.teamCapped = eGreenTeam;
+        plugin->Event(&data);
+    }));
+
+    // Captures queue their messages, so include the tick that sends them
+    report(scenario, "Capture+Tick", measure(iterations, [&](int) {
+        bzfsStub::advanceTime(0.01);
+
+        bz_CTFCaptureEventData_V1 data;
+        data.playerCapping = capper;
+        data.teamCapping = eRedTeam;
+        data.teamCapped = eGreenTeam;
+        plugin->Event(&data);
+
+        bz_TickEventData_V1 tick;
+        plugin->Event(&tick);
+    }));
+
+    // The green flag was just captured, so this exercises the `_delayTeamFlagGrab` denial path
+    report(scenario, "AllowFlagGrab", measure(iterations, [&](int i) {
+        bzfsStub::advanceTime(0.001);
+
+        bz_AllowFlagGrabData_V1 data;
+        data.playerID = capper;
+        data.flagID = (i % 8 == 0) ? regularFlag : flagIDs[1];
+        data.flagType = (i % 8 == 0) ? "SW" : "G*";
+        plugin->Event(&data);
+    }));
+
+    report(scenario, "FlagGrabbed", measure(iterations, [&](int) {
+        bzfsStub::advanceTime(0.01);
+
+        bz_FlagGrabbedEventData_V1 data;
+        data.playerID = capper;
+        data.flagID = flagIDs[1];
+        data.flagType = "G*";
+        plugin->Event(&data);
+    }));
+
+    report(scenario, "FlagDropped", measure(iterations, [&](int) {
+        bzfsStub::advanceTime(0.01);
+
+        bz_FlagDroppedEventData_V1 data;
+        data.playerID = enemy;
+        data.flagID = flagIDs[0];
+        data.flagType = "R*";
+        plugin->Event(&data);
+    }));
+
+    plugin->Cleanup();
+    bz_FreePlugin(plugin);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* configFile = (argc > 1) ? argv[1] : "ctfOverseer.cfg";
+    int iterations = (argc > 2) ? atoi(argv[2]) : 200000;
+
+    if (iterations < 1)
+    {
+        fprintf(stderr, "usage: %s [config file] [iterations >= 1]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<Scenario> scenarios = {
+        {"1v1", {1, 1}},
+        {"4v4", {4, 4}},
+        {"8v6", {8, 6}},
+        {"20v20", {20, 20}},
+        {"4x25", {25, 25, 25, 25}},
+        {"4x50", {50, 50, 50, 50}},
+    };
+
+    printf("%-14s %-20s %12s %14s\n", "teams", "event", "ns/event", "allocs/event");
+
+    for (const Scenario &scenario : scenarios)
+    {
+        runScenario(scenario, configFile, iterations);
+    }
+
+    return 0;
+}
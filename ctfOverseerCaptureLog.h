@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2019 Vladimir "allejo" Jimenez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CTFOVERSEER_CAPTURE_LOG_H
+#define CTFOVERSEER_CAPTURE_LOG_H
+
+#include <stdint.h>
+
+/**
+ * The on-disk format of the capture history log. The log is a directory of fixed-size segment files, each one a
+ * CaptureLogHeader followed by `capacity` CaptureLogRecord slots, of which the first `recordCount` are valid.
+ *
+ * Segments are written by the plug-in through a shared memory mapping and read by ctfOverseerAnalyzer. All fields are
+ * little-endian, matching every platform bzfs runs on.
+ */
+
+const uint32_t CAPTURE_LOG_MAGIC = 0x4C465443; /// "CTFL"
+const uint32_t CAPTURE_LOG_VERSION = 1;
+const char* const CAPTURE_LOG_EXTENSION = ".ctflog";
+
+/// The decision a record describes
+enum CaptureLogKind
+{
+    CAPTURE_LOG_ALLOW_CAPTURE = 1, /// bz_eAllowCTFCaptureEvent; whether the capture was let through
+    CAPTURE_LOG_CAPTURE = 2,       /// bz_eCaptureEvent; the points that were awarded
+};
+
+/// Bit flags stored in CaptureLogRecord::flags
+enum CaptureLogFlags
+{
+    CAPTURE_LOG_UNFAIR = 1 << 0,
+    CAPTURE_LOG_SELF_CAP = 1 << 1,
+    CAPTURE_LOG_DISALLOWED = 1 << 2,
+};
+
+struct CaptureLogHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t recordSize; /// sizeof(CaptureLogRecord) when the segment was written
+    uint32_t capacity; /// The number of record slots in the segment
+    uint64_t recordCount; /// The number of records written; updated after each record is complete
+    int64_t createdWallTime; /// Unix time when the segment was created
+    double createdServerTime; /// bz_getCurrentTime() when the segment was created, to convert record times to wall time
+    uint8_t reserved[24];
+};
+
+struct CaptureLogRecord
+{
+    double serverTime; /// bz_getCurrentTime() of the event
+    int32_t points; /// The points awarded, or that would be awarded if the capture was allowed; negative for penalties
+    uint8_t kind; /// CaptureLogKind
+    uint8_t flags; /// CaptureLogFlags
+    int8_t teamCapping; /// bz_eTeamType of the capping team
+    int8_t teamCapped; /// bz_eTeamType of the team whose flag was captured
+    uint16_t cappingTeamSize;
+    uint16_t cappedTeamSize;
+    uint8_t playerID;
+    uint8_t reserved[11];
+};
+
+static_assert(sizeof(CaptureLogHeader) == 64, "CaptureLogHeader must stay 64 bytes");
+static_assert(sizeof(CaptureLogRecord) == 32, "CaptureLogRecord must stay 32 bytes");
+
+#endif
@@ -0,0 +1,1717 @@
+/*
+ * Copyright (C) 2019 Vladimir "allejo" Jimenez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// End-to-end load testing for CTF Overseer. Event traces describe what bzfs would do during a match (players joining,
+// touching flags, capturing, ...) and are replayed through the plug-in's Event() and GeneralCallback() with the stand-in
+// bzfs API in ctfOverseerStubs.cpp, measuring throughput, tail latency and heap growth along the way.
+//
+// Usage: ctfOverseerReplay generate [-s storm] [-p players] [-t teams] [-d seconds] [-r actions/s] [-k tick interval]
+//                                   [-g grab delay] [-x seed] [-b] <trace file>
+//        ctfOverseerReplay replay [-c config file] [-x speed] [-l listeners] <trace file>
+//        ctfOverseerReplay convert [-b] <input trace> <output trace>
+//
+// Storms are `flag-touch`, `team-switch`, `capture-burst` and `mixed`. -b writes the binary format instead of text. The
+// generator assumes the plug-in's default BZDB settings, with -g standing in for `_delayTeamFlagGrab`.
+// Replays run as fast as possible unless a speed is given; 1 replays in real time, 10 ten times as fast. -l registers
+// the given number of no-op capture listeners.
+//
+// Traces come in a text and a binary format. Both start by describing themselves. A text trace starts with the line
+// `ctfOverseer-trace 1` and has one record per line:
+//
+//     <time> flag <flag ID> <flag type>                 A flag in the world; all of them are added before loading
+//     <time> join <player ID> <team> <callsign>
+//     <time> part <player ID>
+//     <time> spawn <player ID> <team>                    Also how team switches made by other plug-ins show up
+//     <time> touch <player ID> <flag ID>                 AllowFlagGrab, followed by FlagGrabbed if it was allowed
+//     <time> drop <player ID> <flag ID>
+//     <time> capture <player ID> <capping team> <capped team>
+//                                                        AllowCTFCapture, followed by Capture if it was allowed
+//     <time> tick
+//     <time> bzdb <variable> <value>
+//     <time> callback <calcBonusPoints|isFairCapture> <capping team> <capped team>
+//
+// Teams are `rogue`, `red`, `green`, `blue`, `purple` or `observer`. Lines starting with `#` are comments.
+//
+// A binary trace starts with the magic `CFOTRACE`, a version and the table of record kinds it uses (name and number of
+// strings) so readers don't depend on the order of TraceKind. Every record is then a double time, its kind's index
+// in the table, the two teams, a reserved byte, the player and flag IDs as int32 and the kind's strings, each prefixed
+// with a uint16 length. Numbers are in the byte order of the machine that wrote the trace.
+//
+// Replays are driven by the trace, not by the plug-in, so a record that no longer makes sense (e.g. dropping a flag
+// whose grab the plug-in just denied) is skipped and counted.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "ctfOverseerAPI.h"
+#include "ctfOverseerStubs.h"
+
+#include "bzfsAPI.h"
+
+extern "C" bz_Plugin* bz_GetPlugin(void);
+extern "C" void bz_FreePlugin(bz_Plugin* plugin);
+
+//
+// Heap accounting
+//
+
+static std::atomic<uint64_t> allocations(0);
+static std::atomic<int64_t> liveBytes(0);
+static std::atomic<int64_t> peakLiveBytes(0);
+
+/// Prepended to every allocation so deletes know how much to subtract; 16 bytes keeps malloc's alignment
+struct AllocationHeader
+{
+    size_t size;
+    size_t reserved;
+};
+
+static void* allocate(size_t size)
+{
+    AllocationHeader* header = (AllocationHeader*)malloc(sizeof(AllocationHeader) + size);
+
+    if (!header)
+    {
+        return NULL;
+    }
+
+    header->size = size;
+
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    int64_t live = liveBytes.fetch_add((int64_t)size, std::memory_order_relaxed) + (int64_t)size;
+    int64_t peak = peakLiveBytes.load(std::memory_order_relaxed);
+
+    while (live > peak && !peakLiveBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+
+    return header + 1;
+}
+
+static void deallocate(void* ptr)
+{
+    if (!ptr)
+    {
+        return;
+    }
+
+    AllocationHeader* header = (AllocationHeader*)ptr - 1;
+
+    liveBytes.fetch_sub((int64_t)header->size, std::memory_order_relaxed);
+    free(header);
+}
+
+void* operator new(size_t size)
+{
+    if (void* ptr = allocate(size))
+    {
+        return ptr;
+    }
+
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+    deallocate(ptr);
+}
+
+//
+// Trace format
+//
+
+const char TRACE_MAGIC[8] = {'C', 'F', 'O', 'T', 'R', 'A', 'C', 'E'};
+const uint32_t TRACE_VERSION = 1;
+const char* const TRACE_TEXT_HEADER = "ctfOverseer-trace";
+
+enum class TraceKind : uint8_t
+{
+    Flag,
+    Join,
+    Part,
+    Spawn,
+    Touch,
+    Drop,
+    Capture,
+    Tick,
+    BZDB,
+    Callback,
+    Last
+};
+
+struct TraceKindInfo
+{
+    const char* name;
+    int strings; /// The number of strings a record of this kind carries
+};
+
+const TraceKindInfo TRACE_KINDS[(size_t)TraceKind::Last] = {
+    {"flag", 1},
+    {"join", 1},
+    {"part", 0},
+    {"spawn", 0},
+    {"touch", 0},
+    {"drop", 0},
+    {"capture", 0},
+    {"tick", 0},
+    {"bzdb", 2},
+    {"callback", 1},
+};
+
+struct TraceRecord
+{
+    double time = 0;
+    TraceKind kind = TraceKind::Tick;
+    bz_eTeamType team = eNoTeam;
+    bz_eTeamType otherTeam = eNoTeam;
+    int player = -1;
+    int flag = -1;
+    std::string text[2];
+};
+
+struct TeamName
+{
+    const char* name;
+    bz_eTeamType team;
+};
+
+const TeamName TEAM_NAMES[] = {
+    {"rogue", eRogueTeam},
+    {"red", eRedTeam},
+    {"green", eGreenTeam},
+    {"blue", eBlueTeam},
+    {"purple", ePurpleTeam},
+    {"observer", eObservers},
+};
+
+const char* const TEAM_FLAGS[] = {"", "R*", "G*", "B*", "P*"};
+
+static const char* teamName(bz_eTeamType team)
+{
+    for (const TeamName &entry : TEAM_NAMES)
+    {
+        if (entry.team == team)
+        {
+            return entry.name;
+        }
+    }
+
+    return "none";
+}
+
+static bool parseTeam(const std::string &name, bz_eTeamType &team)
+{
+    for (const TeamName &entry : TEAM_NAMES)
+    {
+        if (name == entry.name)
+        {
+            team = entry.team;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool isKnownCallback(const std::string &name)
+{
+    return name == "calcBonusPoints" || name == "isFairCapture";
+}
+
+class TraceWriter
+{
+public:
+    TraceWriter() : binary(false) {}
+
+    bool open(const std::string &path, bool binaryFormat)
+    {
+        binary = binaryFormat;
+        out.open(path.c_str(), binary ? std::ios::out | std::ios::binary : std::ios::out);
+
+        if (!out)
+        {
+            return false;
+        }
+
+        if (binary)
+        {
+            uint32_t kindCount = (uint32_t)TraceKind::Last;
+
+            out.write(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+            write(TRACE_VERSION);
+            write(kindCount);
+
+            for (const TraceKindInfo &kind : TRACE_KINDS)
+            {
+                uint8_t length = (uint8_t)strlen(kind.name);
+                uint8_t strings = (uint8_t)kind.strings;
+
+                write(length);
+                out.write(kind.name, length);
+                write(strings);
+            }
+        }
+        else
+        {
+            out << TRACE_TEXT_HEADER << " " << TRACE_VERSION << "\n";
+        }
+
+        return (bool)out;
+    }
+
+    void add(const TraceRecord &record)
+    {
+        if (binary)
+        {
+            uint8_t kind = (uint8_t)record.kind;
+            int8_t team = (int8_t)record.team;
+            int8_t otherTeam = (int8_t)record.otherTeam;
+            uint8_t reserved = 0;
+            int32_t player = record.player;
+            int32_t flag = record.flag;
+
+            write(record.time);
+            write(kind);
+            write(team);
+            write(otherTeam);
+            write(reserved);
+            write(player);
+            write(flag);
+
+            for (int i = 0; i < TRACE_KINDS[kind].strings; i++)
+            {
+                uint16_t length = (uint16_t)std::min<size_t>(record.text[i].size(), UINT16_MAX);
+
+                write(length);
+                out.write(record.text[i].data(), length);
+            }
+
+            return;
+        }
+
+        char time[32];
+        snprintf(time, sizeof(time), "%.4f", record.time);
+
+        out << time << " " << TRACE_KINDS[(size_t)record.kind].name;
+
+        switch (record.kind)
+        {
+            case TraceKind::Flag:
+                out << " " << record.flag << " " << record.text[0];
+                break;
+
+            case TraceKind::Join:
+                out << " " << record.player << " " << teamName(record.team) << " " << record.text[0];
+                break;
+
+            case TraceKind::Part:
+                out << " " << record.player;
+                break;
+
+            case TraceKind::Spawn:
+                out << " " << record.player << " " << teamName(record.team);
+                break;
+
+            case TraceKind::Touch:
+            case TraceKind::Drop:
+                out << " " << record.player << " " << record.flag;
+                break;
+
+            case TraceKind::Capture:
+                out << " " << record.player << " " << teamName(record.team) << " " << teamName(record.otherTeam);
+                break;
+
+            case TraceKind::BZDB:
+                out << " " << record.text[0] << " " << record.text[1];
+                break;
+
+            case TraceKind::Callback:
+                out << " " << record.text[0] << " " << teamName(record.team) << " " << teamName(record.otherTeam);
+                break;
+
+            default:
+                break;
+        }
+
+        out << "\n";
+    }
+
+    bool close()
+    {
+        out.close();
+
+        return !out.fail();
+    }
+
+private:
+    template <typename T>
+    void write(const T &value)
+    {
+        out.write((const char*)&value, sizeof(T));
+    }
+
+    bool binary;
+    std::ofstream out;
+};
+
+class TraceReader
+{
+public:
+    /// Read a whole trace, detecting its format; on failure `error` says why
+    bool read(const std::string &path, std::vector<TraceRecord> &records, std::string &error)
+    {
+        std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+
+        if (!in)
+        {
+            error = "cannot open " + path;
+            return false;
+        }
+
+        char magic[sizeof(TRACE_MAGIC)];
+
+        if (in.read(magic, sizeof(magic)) && memcmp(magic, TRACE_MAGIC, sizeof(magic)) == 0)
+        {
+            return readBinary(in, records, error);
+        }
+
+        in.clear();
+        in.seekg(0);
+
+        return readText(in, records, error);
+    }
+
+private:
+    template <typename T>
+    static bool read(std::istream &in, T &value)
+    {
+        return (bool)in.read((char*)&value, sizeof(T));
+    }
+
+    static bool readBinary(std::istream &in, std::vector<TraceRecord> &records, std::string &error)
+    {
+        uint32_t version, kindCount;
+
+        if (!read(in, version) || !read(in, kindCount) || version != TRACE_VERSION)
+        {
+            error = "unsupported binary trace version";
+            return false;
+        }
+
+        // Map the trace's kinds onto ours by name
+        std::vector<TraceKind> kinds(kindCount, TraceKind::Last);
+        std::vector<int> strings(kindCount, 0);
+
+        for (uint32_t i = 0; i < kindCount; i++)
+        {
+            uint8_t length, stringCount;
+            char name[256];
+
+            if (!read(in, length) || !in.read(name, length) || !read(in, stringCount))
+            {
+                error = "truncated kind table";
+                return false;
+            }
+
+            strings[i] = stringCount;
+
+            for (size_t k = 0; k < (size_t)TraceKind::Last; k++)
+            {
+                if (strlen(TRACE_KINDS[k].name) == length && memcmp(TRACE_KINDS[k].name, name, length) == 0)
+                {
+                    kinds[i] = (TraceKind)k;
+                }
+            }
+        }
+
+        while (true)
+        {
+            TraceRecord record;
+            uint8_t kind, reserved;
+            int8_t team, otherTeam;
+            int32_t player, flag;
+
+            if (!read(in, record.time))
+            {
+                break;
+            }
+
+            if (!read(in, kind) || !read(in, team) || !read(in, otherTeam) || !read(in, reserved) || !read(in, player) ||
+                !read(in, flag) || kind >= kindCount)
+            {
+                error = "truncated or corrupt record " + std::to_string(records.size());
+                return false;
+            }
+
+            record.team = (bz_eTeamType)team;
+            record.otherTeam = (bz_eTeamType)otherTeam;
+            record.player = player;
+            record.flag = flag;
+
+            for (int i = 0; i < strings[kind]; i++)
+            {
+                uint16_t length;
+                std::string text;
+
+                if (!read(in, length))
+                {
+                    error = "truncated record " + std::to_string(records.size());
+                    return false;
+                }
+
+                text.resize(length);
+
+                if (length > 0 && !in.read(&text[0], length))
+                {
+                    error = "truncated record " + std::to_string(records.size());
+                    return false;
+                }
+
+                if (i < 2)
+                {
+                    record.text[i] = text;
+                }
+            }
+
+            // Kinds this version doesn't know about are skipped, which is what the kind table is for
+            if (kinds[kind] == TraceKind::Last)
+            {
+                continue;
+            }
+
+            record.kind = kinds[kind];
+            records.push_back(record);
+        }
+
+        return true;
+    }
+
+    static bool readText(std::istream &in, std::vector<TraceRecord> &records, std::string &error)
+    {
+        std::string line;
+        int lineNumber = 0;
+        bool sawHeader = false;
+
+        while (std::getline(in, line))
+        {
+            lineNumber++;
+
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+
+            std::istringstream fields(line);
+
+            if (!sawHeader)
+            {
+                std::string header;
+                uint32_t version = 0;
+
+                if (!(fields >> header >> version) || header != TRACE_TEXT_HEADER || version != TRACE_VERSION)
+                {
+                    error = "not a ctfOverseer trace, or an unsupported version";
+                    return false;
+                }
+
+                sawHeader = true;
+                continue;
+            }
+
+            TraceRecord record;
+            std::string kind, team, otherTeam;
+            bool valid = (bool)(fields >> record.time >> kind);
+
+            if (valid && kind == "flag")
+            {
+                record.kind = TraceKind::Flag;
+                valid = (bool)(fields >> record.flag >> record.text[0]);
+            }
+            else if (valid && kind == "join")
+            {
+                record.kind = TraceKind::Join;
+                valid = (fields >> record.player >> team) && parseTeam(team, record.team) && (fields >> record.text[0]);
+            }
+            else if (valid && kind == "part")
+            {
+                record.kind = TraceKind::Part;
+                valid = (bool)(fields >> record.player);
+            }
+            else if (valid && kind == "spawn")
+            {
+                record.kind = TraceKind::Spawn;
+                valid = (fields >> record.player >> team) && parseTeam(team, record.team);
+            }
+            else if (valid && (kind == "touch" || kind == "drop"))
+            {
+                record.kind = (kind == "touch") ? TraceKind::Touch : TraceKind::Drop;
+                valid = (bool)(fields >> record.player >> record.flag);
+            }
+            else if (valid && kind == "capture")
+            {
+                record.kind = TraceKind::Capture;
+                valid = (fields >> record.player >> team >> otherTeam) && parseTeam(team, record.team) && parseTeam(otherTeam, record.otherTeam);
+            }
+            else if (valid && kind == "tick")
+            {
+                record.kind = TraceKind::Tick;
+            }
+            else if (valid && kind == "bzdb")
+            {
+                record.kind = TraceKind::BZDB;
+                valid = (bool)(fields >> record.text[0] >> record.text[1]);
+            }
+            else if (valid && kind == "callback")
+            {
+                record.kind = TraceKind::Callback;
+                valid = (fields >> record.text[0] >> team >> otherTeam) && parseTeam(team, record.team) &&
+                    parseTeam(otherTeam, record.otherTeam) && isKnownCallback(record.text[0]);
+            }
+            else
+            {
+                valid = false;
+            }
+
+            if (!valid)
+            {
+                error = "invalid record on line " + std::to_string(lineNumber) + ": " + line;
+                return false;
+            }
+
+            records.push_back(record);
+        }
+
+        if (!sawHeader)
+        {
+            error = "empty trace";
+            return false;
+        }
+
+        return true;
+    }
+};
+
+//
+// Synthetic storms
+//
+
+const int MAX_STORM_TEAMS = 4; /// Red, green, blue and purple
+const double COOLDOWN_MARGIN = 0.25; /// Flag cooldowns end on a tick, so nobody touches a flag this close to the end of one
+const char* const REGULAR_FLAGS[] = {"SW", "GM", "L", "V", "SB", "OO", "ST", "CL"};
+
+enum class StormType
+{
+    FlagTouch,   /// Everybody keeps driving over flags, most of which are cooling down or carried
+    TeamSwitch,  /// Players keep leaving and rejoining on other teams, dropping what they carry
+    CaptureBurst, /// Quiet play interrupted by bursts where every carrier captures at once
+    Mixed,
+};
+
+struct StormSettings
+{
+    StormType storm = StormType::Mixed;
+    int players = 200;
+    int teams = MAX_STORM_TEAMS;
+    double seconds = 60;
+    double rate = 2000;          /// Player actions per second, across all players
+    double tickInterval = 0.05;  /// How often bzfs ticks the plug-in; it never waits longer than MaxWaitTime
+    int grabDelay = 20;          /// The `_delayTeamFlagGrab` the replay will run with, so denied grabs aren't followed up on
+    uint64_t seed = 1;
+};
+
+/// SplitMix64, as in the simulator; seeded so the same settings always generate the same trace
+struct Random
+{
+    uint64_t state;
+
+    explicit Random(uint64_t seed) : state(seed) {}
+
+    uint64_t next()
+    {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+        return z ^ (z >> 31);
+    }
+
+    double uniform()
+    {
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    int below(int bound)
+    {
+        return (int)(uniform() * bound);
+    }
+};
+
+class StormGenerator
+{
+public:
+    StormGenerator(const StormSettings &_settings, TraceWriter &_writer) :
+        settings(_settings),
+        writer(_writer),
+        random(_settings.seed),
+        now(0),
+        records(0)
+    {
+    }
+
+    uint64_t generate()
+    {
+        for (int t = 0; t < settings.teams; t++)
+        {
+            addFlag(TEAM_FLAGS[eRedTeam + t]);
+            cooldownEnds.push_back(0);
+        }
+
+        for (const char* flag : REGULAR_FLAGS)
+        {
+            addFlag(flag);
+        }
+
+        for (int p = 0; p < settings.players; p++)
+        {
+            players.push_back({false, eNoTeam, -1});
+            join(p, teamAt(p % settings.teams));
+        }
+
+        double nextTick = settings.tickInterval;
+
+        while (true)
+        {
+            now += -std::log(1.0 - random.uniform()) / currentRate();
+
+            if (now >= settings.seconds)
+            {
+                break;
+            }
+
+            while (nextTick <= now)
+            {
+                emit(TraceKind::Tick, nextTick);
+                flush();
+
+                nextTick += settings.tickInterval;
+            }
+
+            act();
+        }
+
+        return records;
+    }
+
+private:
+    struct Player
+    {
+        bool active;
+        bz_eTeamType team;
+        int flag;
+    };
+
+    bz_eTeamType teamAt(int index) const
+    {
+        return (bz_eTeamType)(eRedTeam + index);
+    }
+
+    bool isBursting() const
+    {
+        // Half a second of captures every five seconds
+        return fmod(now, 5.0) < 0.5;
+    }
+
+    double currentRate() const
+    {
+        if (settings.storm == StormType::CaptureBurst)
+        {
+            return isBursting() ? settings.rate : settings.rate * 0.1;
+        }
+
+        return settings.rate;
+    }
+
+    TraceRecord& emit(TraceKind kind, double time)
+    {
+        record = TraceRecord();
+        record.kind = kind;
+        record.time = time;
+
+        return record;
+    }
+
+    void flush()
+    {
+        writer.add(record);
+        records++;
+    }
+
+    void addFlag(const char* type)
+    {
+        emit(TraceKind::Flag, 0);
+        record.flag = (int)flagHolders.size();
+        record.text[0] = type;
+        flush();
+
+        flagHolders.push_back(-1);
+        flagTeams.push_back(type[1] == '*' ? teamAt((int)flagHolders.size() - 1) : eNoTeam);
+    }
+
+    void join(int player, bz_eTeamType team)
+    {
+        players[player] = {true, team, -1};
+
+        emit(TraceKind::Join, now);
+        record.player = player;
+        record.team = team;
+        record.text[0] = "player" + std::to_string(player);
+        flush();
+
+        emit(TraceKind::Spawn, now);
+        record.player = player;
+        record.team = team;
+        flush();
+    }
+
+    void drop(int player)
+    {
+        int flag = players[player].flag;
+
+        emit(TraceKind::Drop, now);
+        record.player = player;
+        record.flag = flag;
+        flush();
+
+        players[player].flag = -1;
+        flagHolders[flag] = -1;
+    }
+
+    void touch(int player)
+    {
+        if (players[player].flag >= 0)
+        {
+            return;
+        }
+
+        int flag;
+        double choice = random.uniform();
+
+        if (choice < 0.8)
+        {
+            // An enemy team flag
+            int team = random.below(settings.teams - 1);
+            flag = (teamAt(team) >= players[player].team) ? team + 1 : team;
+        }
+        else if (choice < 0.85)
+        {
+            flag = players[player].team - eRedTeam;
+        }
+        else
+        {
+            flag = settings.teams + random.below((int)(sizeof(REGULAR_FLAGS) / sizeof(REGULAR_FLAGS[0])));
+        }
+
+        bool isEnemyTeamFlag = flagTeams[flag] != eNoTeam && flagTeams[flag] != players[player].team;
+
+        // bzfs only asks about flags lying on the ground
+        if (flagHolders[flag] >= 0 || (isEnemyTeamFlag && fabs(now - cooldownEnds[flag]) < COOLDOWN_MARGIN))
+        {
+            return;
+        }
+
+        emit(TraceKind::Touch, now);
+        record.player = player;
+        record.flag = flag;
+        flush();
+
+        if (isEnemyTeamFlag && now < cooldownEnds[flag])
+        {
+            return;
+        }
+
+        players[player].flag = flag;
+        flagHolders[flag] = player;
+    }
+
+    void capture(int player)
+    {
+        int flag = players[player].flag;
+
+        if (flagTeams[flag] == eNoTeam)
+        {
+            drop(player);
+            return;
+        }
+
+        emit(TraceKind::Capture, now);
+        record.player = player;
+        record.team = players[player].team;
+        record.otherTeam = flagTeams[flag];
+        flush();
+
+        // `_disallowSelfCap` is on by default, so self-capping players keep the flag
+        if (flagTeams[flag] == players[player].team)
+        {
+            return;
+        }
+
+        if (settings.grabDelay >= 0)
+        {
+            cooldownEnds[flag] = now + settings.grabDelay;
+        }
+
+        players[player].flag = -1;
+        flagHolders[flag] = -1;
+    }
+
+    void switchTeam(int player)
+    {
+        if (players[player].flag >= 0)
+        {
+            drop(player);
+        }
+
+        emit(TraceKind::Part, now);
+        record.player = player;
+        flush();
+
+        int team = random.below(settings.teams - 1);
+        join(player, (teamAt(team) >= players[player].team) ? teamAt(team + 1) : teamAt(team));
+    }
+
+    int randomCarrier()
+    {
+        int start = random.below((int)flagHolders.size());
+
+        for (size_t i = 0; i < flagHolders.size(); i++)
+        {
+            int holder = flagHolders[(start + i) % flagHolders.size()];
+
+            if (holder >= 0)
+            {
+                return holder;
+            }
+        }
+
+        return -1;
+    }
+
+    void act()
+    {
+        // Chances of touching, dropping, capturing and switching teams
+        double weights[4];
+
+        switch (settings.storm)
+        {
+            case StormType::FlagTouch:
+                weights[0] = 0.75; weights[1] = 0.2; weights[2] = 0.05; weights[3] = 0;
+                break;
+
+            case StormType::TeamSwitch:
+                weights[0] = 0.3; weights[1] = 0.1; weights[2] = 0.05; weights[3] = 0.55;
+                break;
+
+            case StormType::CaptureBurst:
+                if (isBursting())
+                {
+                    weights[0] = 0.5; weights[1] = 0; weights[2] = 0.5; weights[3] = 0;
+                }
+                else
+                {
+                    weights[0] = 0.6; weights[1] = 0.3; weights[2] = 0.1; weights[3] = 0;
+                }
+                break;
+
+            default:
+                weights[0] = 0.5; weights[1] = 0.2; weights[2] = 0.1; weights[3] = 0.2;
+                break;
+        }
+
+        double choice = random.uniform();
+        int player = random.below(settings.players);
+
+        if ((choice -= weights[0]) < 0)
+        {
+            touch(player);
+        }
+        else if ((choice -= weights[1]) < 0)
+        {
+            if ((player = randomCarrier()) >= 0)
+            {
+                drop(player);
+            }
+        }
+        else if ((choice -= weights[2]) < 0)
+        {
+            if ((player = randomCarrier()) >= 0)
+            {
+                capture(player);
+            }
+        }
+        else
+        {
+            switchTeam(player);
+        }
+    }
+
+    const StormSettings &settings;
+    TraceWriter &writer;
+    Random random;
+
+    double now;
+    uint64_t records;
+    TraceRecord record;
+
+    std::vector<Player> players;
+    std::vector<int> flagHolders; /// The player carrying each flag, or -1
+    std::vector<bz_eTeamType> flagTeams;
+    std::vector<double> cooldownEnds; /// When each team flag may be grabbed by enemies again, indexed like the flags
+};
+
+//
+// Replay
+//
+
+const int CHECKPOINTS = 10; /// How many times heap usage is sampled during a replay
+
+/// Latencies for one record kind; storage is reserved up front so recording doesn't show up in the heap numbers
+struct LatencySamples
+{
+    std::vector<uint32_t> nanoseconds;
+    uint64_t pluginCalls = 0;
+    uint64_t skipped = 0;
+
+    uint32_t percentile(double fraction) const
+    {
+        return nanoseconds.empty() ? 0 : nanoseconds[std::min(nanoseconds.size() - 1, (size_t)(fraction * nanoseconds.size()))];
+    }
+};
+
+struct ReplaySettings
+{
+    std::string configFile = "ctfOverseer.cfg";
+    double speed = 0;   /// 0 replays as fast as possible
+    int listeners = 0;
+};
+
+static void noopListener(const CaptureEventV2 &/*event*/)
+{
+}
+
+class Replayer
+{
+public:
+    explicit Replayer(const std::vector<TraceRecord> &_records) :
+        records(_records),
+        plugin(NULL),
+        skipped(0)
+    {
+    }
+
+    void run(const ReplaySettings &settings)
+    {
+        bzfsStub::reset();
+
+        std::vector<size_t> perKind((size_t)TraceKind::Last, 0);
+
+        for (const TraceRecord &record : records)
+        {
+            perKind[(size_t)record.kind]++;
+
+            if (record.kind == TraceKind::Flag)
+            {
+                setSlot(flags, record.flag, bzfsStub::addFlag(record.text[0].c_str()));
+                setSlot(flagTypes, record.flag, record.text[0]);
+                setSlot(flagHolders, record.flag, -1);
+            }
+        }
+
+        samples.resize((size_t)TraceKind::Last);
+
+        for (size_t k = 0; k < perKind.size(); k++)
+        {
+            samples[k].nanoseconds.reserve(perKind[k]);
+        }
+
+        int64_t heapBeforeLoad = liveBytes.load();
+
+        plugin = bz_GetPlugin();
+        bzfsStub::setActivePlugin(plugin);
+        bzfsStub::setCurrentTime(records.empty() ? 0 : records.front().time);
+        plugin->Init(settings.configFile.c_str());
+
+        OnCaptureEventCallbackV2 listener = noopListener;
+
+        for (int i = 0; i < settings.listeners; i++)
+        {
+            plugin->GeneralCallback("listenOnCaptureV2", &listener);
+        }
+
+        bz_EventData worldFinalized(bz_eWorldFinalized);
+        plugin->Event(&worldFinalized);
+
+        int64_t heapAtStart = liveBytes.load();
+        peakLiveBytes.store(heapAtStart);
+        uint64_t allocationsAtStart = allocations.load();
+        uint64_t pluginCalls = 0;
+        double maxLag = 0;
+
+        char pace[64] = "as fast as possible";
+
+        if (settings.speed > 0)
+        {
+            snprintf(pace, sizeof(pace), "at %gx speed", settings.speed);
+        }
+
+        printf("Replaying %zu records (%.1f seconds of play) %s\n", records.size(), traceDuration(), pace);
+        printf("Plug-in heap after loading: %.1f KiB\n\n", (heapAtStart - heapBeforeLoad) / 1024.0);
+        printf("  %9s %12s %14s %12s\n", "progress", "trace time", "live heap", "allocations");
+
+        auto wallStart = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::duration busy(0);
+        size_t nextCheckpoint = 1;
+
+        for (size_t i = 0; i < records.size(); i++)
+        {
+            const TraceRecord &record = records[i];
+
+            if (settings.speed > 0)
+            {
+                auto scheduled = wallStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>((record.time - records.front().time) / settings.speed));
+
+                std::this_thread::sleep_until(scheduled);
+                maxLag = std::max(maxLag, std::chrono::duration<double>(std::chrono::steady_clock::now() - scheduled).count());
+            }
+
+            bzfsStub::setCurrentTime(record.time);
+
+            auto start = std::chrono::steady_clock::now();
+            int calls = dispatch(record);
+            auto elapsed = std::chrono::steady_clock::now() - start;
+
+            LatencySamples &kindSamples = samples[(size_t)record.kind];
+
+            if (calls > 0)
+            {
+                kindSamples.nanoseconds.push_back((uint32_t)std::min<int64_t>(UINT32_MAX, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+                kindSamples.pluginCalls += calls;
+                pluginCalls += calls;
+                busy += elapsed;
+            }
+            else if (record.kind != TraceKind::Flag)
+            {
+                kindSamples.skipped++;
+                skipped++;
+            }
+
+            while (nextCheckpoint <= CHECKPOINTS && i + 1 >= records.size() * nextCheckpoint / CHECKPOINTS)
+            {
+                printf("  %8d%% %11.1fs %10.1f KiB %12llu\n", (int)(nextCheckpoint * 100 / CHECKPOINTS), record.time,
+                    (liveBytes.load() - heapBeforeLoad) / 1024.0, (unsigned long long)(allocations.load() - allocationsAtStart));
+                nextCheckpoint++;
+            }
+        }
+
+        double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+        double busySeconds = std::chrono::duration<double>(busy).count();
+        int64_t heapAtEnd = liveBytes.load();
+        uint64_t allocationsDuringReplay = allocations.load() - allocationsAtStart;
+
+        printf("\nThroughput\n");
+        printf("  Records replayed:      %zu (%llu skipped as inconsistent)\n", records.size(), (unsigned long long)skipped);
+        printf("  Plug-in calls:         %llu in %.3fs inside the plug-in, %.3fs wall clock\n", (unsigned long long)pluginCalls, busySeconds, wallSeconds);
+        printf("  Calls per second:      %.0f (%.1fx the trace's real-time rate)\n", busySeconds > 0 ? pluginCalls / busySeconds : 0.0,
+            busySeconds > 0 ? traceDuration() / busySeconds : 0.0);
+        printf("  Messages sent:         %llu\n", (unsigned long long)bzfsStub::messagesSent());
+
+        if (settings.speed > 0)
+        {
+            printf("  Most behind schedule:  %.1f ms\n", maxLag * 1000);
+        }
+
+        printf("\nLatency per record, including every plug-in call it causes (ns)\n");
+        printf("  %-10s %10s %10s %10s %10s %10s %10s %10s\n", "record", "count", "skipped", "p50", "p99", "p99.9", "max", "calls");
+
+        for (size_t k = 0; k < samples.size(); k++)
+        {
+            LatencySamples &kindSamples = samples[k];
+
+            if (kindSamples.nanoseconds.empty() && kindSamples.skipped == 0)
+            {
+                continue;
+            }
+
+            std::sort(kindSamples.nanoseconds.begin(), kindSamples.nanoseconds.end());
+
+            printf("  %-10s %10zu %10llu %10u %10u %10u %10u %10llu\n", TRACE_KINDS[k].name, kindSamples.nanoseconds.size(),
+                (unsigned long long)kindSamples.skipped, kindSamples.percentile(0.5), kindSamples.percentile(0.99),
+                kindSamples.percentile(0.999), kindSamples.nanoseconds.empty() ? 0 : kindSamples.nanoseconds.back(),
+                (unsigned long long)kindSamples.pluginCalls);
+        }
+
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+
+        printf("\nMemory\n");
+        printf("  Heap growth:           %+.1f KiB during the replay (peak %.1f KiB above the start)\n", (heapAtEnd - heapAtStart) / 1024.0,
+            (peakLiveBytes.load() - heapAtStart) / 1024.0);
+        printf("  Allocations:           %llu (%.3f per plug-in call)\n", (unsigned long long)allocationsDuringReplay,
+            pluginCalls ? (double)allocationsDuringReplay / pluginCalls : 0.0);
+        printf("  Peak resident set:     %ld KiB\n", (long)usage.ru_maxrss);
+
+        plugin->Cleanup();
+        bz_FreePlugin(plugin);
+    }
+
+private:
+    template <typename T>
+    static void setSlot(std::vector<T> &slots, int index, const T &value)
+    {
+        if (index < 0)
+        {
+            return;
+        }
+
+        if ((size_t)index >= slots.size())
+        {
+            slots.resize(index + 1, T());
+        }
+
+        slots[index] = value;
+    }
+
+    double traceDuration() const
+    {
+        return records.empty() ? 0 : records.back().time - records.front().time;
+    }
+
+    int stubPlayer(int player) const
+    {
+        return (player >= 0 && (size_t)player < players.size()) ? players[player] : -1;
+    }
+
+    bool isFlag(int flag) const
+    {
+        return flag >= 0 && (size_t)flag < flags.size();
+    }
+
+    /// Feed one record to the plug-in the way bzfs would and return how many calls that took, or 0 if it doesn't apply
+    int dispatch(const TraceRecord &record)
+    {
+        int playerID = stubPlayer(record.player);
+
+        switch (record.kind)
+        {
+            case TraceKind::Flag:
+                return 0;
+
+            case TraceKind::Join:
+            {
+                if (playerID >= 0 || record.player < 0 || (playerID = bzfsStub::addPlayer(record.team, record.text[0].c_str())) < 0)
+                {
+                    break;
+                }
+
+                setSlot(players, record.player, playerID);
+                setSlot(playerFlags, record.player, -1);
+
+                bz_BasePlayerRecord playerRecord;
+                playerRecord.playerID = playerID;
+                playerRecord.team = record.team;
+                playerRecord.callsign = record.text[0];
+
+                bz_PlayerJoinPartEventData_V1 data;
+                data.eventTime = record.time;
+                data.playerID = playerID;
+                data.record = &playerRecord;
+                plugin->Event(&data);
+
+                return 1;
+            }
+
+            case TraceKind::Part:
+            {
+                if (playerID < 0)
+                {
+                    break;
+                }
+
+                bz_PlayerJoinPartEventData_V1 data;
+                data.eventType = bz_ePlayerPartEvent;
+                data.eventTime = record.time;
+                data.playerID = playerID;
+                plugin->Event(&data);
+
+                // bzfs drops the flag of a leaving player; a trace recorded from it has the drop before this record
+                release(record.player);
+                bzfsStub::removePlayer(playerID);
+                players[record.player] = -1;
+
+                return 1;
+            }
+
+            case TraceKind::Spawn:
+            {
+                if (playerID < 0)
+                {
+                    break;
+                }
+
+                bzfsStub::setPlayerTeam(playerID, record.team);
+
+                bz_PlayerSpawnEventData_V1 data;
+                data.eventTime = record.time;
+                data.playerID = playerID;
+                data.team = record.team;
+                plugin->Event(&data);
+
+                return 1;
+            }
+
+            case TraceKind::Touch:
+            {
+                if (playerID < 0 || !isFlag(record.flag) || playerFlags[record.player] >= 0 || flagHolders[record.flag] >= 0)
+                {
+                    break;
+                }
+
+                bz_AllowFlagGrabData_V1 allowGrab;
+                allowGrab.eventTime = record.time;
+                allowGrab.playerID = playerID;
+                allowGrab.flagID = flags[record.flag];
+                allowGrab.flagType = flagTypes[record.flag].c_str();
+                plugin->Event(&allowGrab);
+
+                if (!allowGrab.allow)
+                {
+                    return 1;
+                }
+
+                playerFlags[record.player] = record.flag;
+                flagHolders[record.flag] = record.player;
+                bzfsStub::setPlayerFlag(playerID, flags[record.flag]);
+
+                bz_FlagGrabbedEventData_V1 grabbed;
+                grabbed.eventTime = record.time;
+                grabbed.playerID = playerID;
+                grabbed.flagID = flags[record.flag];
+                grabbed.flagType = flagTypes[record.flag].c_str();
+                plugin->Event(&grabbed);
+
+                return 2;
+            }
+
+            case TraceKind::Drop:
+            {
+                if (playerID < 0 || !isFlag(record.flag) || playerFlags[record.player] != record.flag)
+                {
+                    break;
+                }
+
+                release(record.player);
+
+                bz_FlagDroppedEventData_V1 data;
+                data.eventTime = record.time;
+                data.playerID = playerID;
+                data.flagID = flags[record.flag];
+                data.flagType = flagTypes[record.flag].c_str();
+                plugin->Event(&data);
+
+                return 1;
+            }
+
+            case TraceKind::Capture:
+            {
+                if (playerID < 0 || playerFlags[record.player] < 0)
+                {
+                    break;
+                }
+
+                bz_AllowCTFCaptureEventData_V1 allowCapture;
+                allowCapture.eventTime = record.time;
+                allowCapture.playerCapping = playerID;
+                allowCapture.teamCapping = record.team;
+                allowCapture.teamCapped = record.otherTeam;
+                plugin->Event(&allowCapture);
+
+                if (!allowCapture.allow)
+                {
+                    // Denied unfair captures take the flag away
+                    if (bz_getPlayerFlagID(playerID) < 0)
+                    {
+                        release(record.player);
+                    }
+
+                    return 1;
+                }
+
+                bz_CTFCaptureEventData_V1 capture;
+                capture.eventTime = record.time;
+                capture.playerCapping = playerID;
+                capture.teamCapping = record.team;
+                capture.teamCapped = record.otherTeam;
+                plugin->Event(&capture);
+
+                release(record.player);
+
+                return 2;
+            }
+
+            case TraceKind::Tick:
+            {
+                bz_TickEventData_V1 data;
+                data.eventTime = record.time;
+                plugin->Event(&data);
+
+                return 1;
+            }
+
+            case TraceKind::BZDB:
+            {
+                bzfsStub::setBZDB(record.text[0], record.text[1]);
+
+                bz_BZDBChangeData_V1 data(record.text[0], record.text[1]);
+                data.eventTime = record.time;
+                plugin->Event(&data);
+
+                return 1;
+            }
+
+            case TraceKind::Callback:
+            {
+                if (!isKnownCallback(record.text[0]))
+                {
+                    break;
+                }
+
+                TeamPair pair(record.team, record.otherTeam);
+                plugin->GeneralCallback(record.text[0].c_str(), &pair);
+
+                return 1;
+            }
+
+            default:
+                break;
+        }
+
+        return 0;
+    }
+
+    void release(int player)
+    {
+        int flag = playerFlags[player];
+
+        if (flag >= 0)
+        {
+            flagHolders[flag] = -1;
+            playerFlags[player] = -1;
+            bzfsStub::setPlayerFlag(players[player], -1);
+        }
+    }
+
+    const std::vector<TraceRecord> &records;
+    bz_Plugin* plugin;
+    uint64_t skipped;
+
+    std::vector<LatencySamples> samples; /// Indexed by TraceKind
+
+    // Trace IDs mapped onto the stub's
+    std::vector<int> players;
+    std::vector<int> flags;
+    std::vector<std::string> flagTypes;
+
+    std::vector<int> playerFlags; /// The trace flag each trace player carries, or -1
+    std::vector<int> flagHolders; /// The trace player carrying each trace flag, or -1
+};
+
+//
+// Command line
+//
+
+static void usage(const char* program)
+{
+    fprintf(stderr, "usage: %s generate [-s flag-touch|team-switch|capture-burst|mixed] [-p players] [-t teams] [-d seconds]\n", program);
+    fprintf(stderr, "       %*s          [-r actions/s] [-k tick interval] [-g grab delay] [-x seed] [-b] <trace file>\n", (int)strlen(program), "");
+    fprintf(stderr, "       %s replay [-c config file] [-x speed] [-l listeners] <trace file>\n", program);
+    fprintf(stderr, "       %s convert [-b] <input trace> <output trace>\n", program);
+}
+
+static bool parseStorm(const char* name, StormType &storm)
+{
+    const struct { const char* name; StormType storm; } storms[] = {
+        {"flag-touch", StormType::FlagTouch},
+        {"team-switch", StormType::TeamSwitch},
+        {"capture-burst", StormType::CaptureBurst},
+        {"mixed", StormType::Mixed},
+    };
+
+    for (const auto &entry : storms)
+    {
+        if (strcmp(name, entry.name) == 0)
+        {
+            storm = entry.storm;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static int generate(int argc, char* argv[])
+{
+    StormSettings settings;
+    bool binary = false;
+    std::string path;
+
+    for (int i = 2; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+
+        if (strcmp(argv[i], "-s") == 0 && hasValue)
+        {
+            if (!parseStorm(argv[++i], settings.storm))
+            {
+                fprintf(stderr, "error: unknown storm: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-p") == 0 && hasValue)
+        {
+            settings.players = std::max(1, std::min(200, atoi(argv[++i])));
+        }
+        else if (strcmp(argv[i], "-t") == 0 && hasValue)
+        {
+            settings.teams = std::max(2, std::min(MAX_STORM_TEAMS, atoi(argv[++i])));
+        }
+        else if (strcmp(argv[i], "-d") == 0 && hasValue)
+        {
+            settings.seconds = std::max(1.0, atof(argv[++i]));
+        }
+        else if (strcmp(argv[i], "-r") == 0 && hasValue)
+        {
+            settings.rate = std::max(1.0, atof(argv[++i]));
+        }
+        else if (strcmp(argv[i], "-g") == 0 && hasValue)
+        {
+            settings.grabDelay = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-k") == 0 && hasValue)
+        {
+            settings.tickInterval = std::max(0.001, atof(argv[++i]));
+        }
+        else if (strcmp(argv[i], "-x") == 0 && hasValue)
+        {
+            settings.seed = strtoull(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "-b") == 0)
+        {
+            binary = true;
+        }
+        else if (argv[i][0] != '-' && path.empty())
+        {
+            path = argv[i];
+        }
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    TraceWriter writer;
+
+    if (path.empty())
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (!writer.open(path, binary))
+    {
+        fprintf(stderr, "error: cannot write %s\n", path.c_str());
+        return 1;
+    }
+
+    uint64_t records = StormGenerator(settings, writer).generate();
+
+    if (!writer.close())
+    {
+        fprintf(stderr, "error: cannot write %s\n", path.c_str());
+        return 1;
+    }
+
+    printf("Wrote %llu records covering %.0f seconds to %s\n", (unsigned long long)records, settings.seconds, path.c_str());
+
+    return 0;
+}
+
+static int replay(int argc, char* argv[])
+{
+    ReplaySettings settings;
+    std::string path;
+
+    for (int i = 2; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+
+        if (strcmp(argv[i], "-c") == 0 && hasValue)
+        {
+            settings.configFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "-x") == 0 && hasValue)
+        {
+            settings.speed = std::max(0.0, atof(argv[++i]));
+        }
+        else if (strcmp(argv[i], "-l") == 0 && hasValue)
+        {
+            settings.listeners = std::max(0, atoi(argv[++i]));
+        }
+        else if (argv[i][0] != '-' && path.empty())
+        {
+            path = argv[i];
+        }
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (path.empty())
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<TraceRecord> records;
+    std::string error;
+
+    if (!TraceReader().read(path, records, error))
+    {
+        fprintf(stderr, "error: %s\n", error.c_str());
+        return 1;
+    }
+
+    Replayer(records).run(settings);
+
+    return 0;
+}
+
+static int convert(int argc, char* argv[])
+{
+    bool binary = false;
+    std::vector<std::string> paths;
+
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-b") == 0)
+        {
+            binary = true;
+        }
+        else
+        {
+            paths.push_back(argv[i]);
+        }
+    }
+
+    if (paths.size() != 2)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<TraceRecord> records;
+    std::string error;
+    TraceWriter writer;
+
+    if (!TraceReader().read(paths[0], records, error))
+    {
+        fprintf(stderr, "error: %s\n", error.c_str());
+        return 1;
+    }
+
+    if (!writer.open(paths[1], binary))
+    {
+        fprintf(stderr, "error: cannot write %s\n", paths[1].c_str());
+        return 1;
+    }
+
+    for (const TraceRecord &record : records)
+    {
+        writer.add(record);
+    }
+
+    if (!writer.close())
+    {
+        fprintf(stderr, "error: cannot write %s\n", paths[1].c_str());
+        return 1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1 && strcmp(argv[1], "generate") == 0)
+    {
+        return generate(argc, argv);
+    }
+    else if (argc > 1 && strcmp(argv[1], "replay") == 0)
+    {
+        return replay(argc, argv);
+    }
+    else if (argc > 1 && strcmp(argv[1], "convert") == 0)
+    {
+        return convert(argc, argv);
+    }
+
+    usage(argv[0]);
+
+    return 1;
+}
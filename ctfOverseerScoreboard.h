@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2019 Vladimir "allejo" Jimenez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CTFOVERSEER_SCOREBOARD_H
+#define CTFOVERSEER_SCOREBOARD_H
+
+#include <atomic>
+#include <cstring>
+#include <stdint.h>
+
+/**
+ * The layout of the shared memory scoreboard published by the plug-in's `scoreboard_shm_name` option. Map the segment
+ * read-only with shm_open() and mmap() and use readScoreboard() to take consistent copies of it; reading never blocks
+ * or signals the server.
+ */
+
+const uint32_t SCOREBOARD_MAGIC = 0x42534643; /// "CFSB"
+const uint32_t SCOREBOARD_VERSION = 1;
+const int SCOREBOARD_TEAMS = 5; /// Arrays are indexed by bz_eTeamType: rogue, red, green, blue and purple
+
+struct ScoreboardSnapshot
+{
+    double wallTime; /// Unix time, with fractions of a second, when the snapshot was written
+    double serverTime; /// bz_getCurrentTime() when the snapshot was written
+
+    int32_t teamSize[SCOREBOARD_TEAMS];
+    int32_t bonus[SCOREBOARD_TEAMS][SCOREBOARD_TEAMS]; /// What a capture would be worth right now, by [capping][capped]
+    int32_t capBonus[SCOREBOARD_TEAMS][SCOREBOARD_TEAMS]; /// The bonus locked in when [capping] last grabbed [capped]'s flag
+    int32_t reserved;
+
+    /// Seconds until each team flag may be grabbed again, as of `wallTime`; 0 if it may already be grabbed
+    double cooldownRemaining[SCOREBOARD_TEAMS];
+
+    uint64_t captures[SCOREBOARD_TEAMS]; /// Captures by the capping team since the plug-in was loaded
+    uint64_t unfairCaptures[SCOREBOARD_TEAMS];
+    uint64_t selfCaptures[SCOREBOARD_TEAMS];
+};
+
+struct ScoreboardSegment
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size; /// sizeof(ScoreboardSegment) when the segment was created
+    uint32_t reserved;
+
+    /// A seqlock: odd while the snapshot is being written, and bumped by two for every published snapshot
+    std::atomic<uint64_t> sequence;
+
+    ScoreboardSnapshot snapshot;
+};
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "The scoreboard needs lock-free 64-bit atomics to be shared between processes");
+
+enum class ScoreboardRead
+{
+    Copied,
+    NothingPublished, /// The plug-in hasn't published a snapshot since it created the segment
+    Busy,             /// A snapshot was being written on every attempt, or the plug-in stopped in the middle of writing one
+};
+
+/**
+ * Copy a consistent snapshot out of a mapped scoreboard segment, retrying up to `attempts` times while the plug-in is
+ * writing one.
+ */
+inline ScoreboardRead readScoreboard(const ScoreboardSegment* segment, ScoreboardSnapshot &out, int attempts = 1000)
+{
+    for (int i = 0; i < attempts; i++)
+    {
+        uint64_t before = segment->sequence.load(std::memory_order_acquire);
+
+        if (before == 0)
+        {
+            return ScoreboardRead::NothingPublished;
+        }
+
+        if (before & 1)
+        {
+            continue;
+        }
+
+        memcpy(&out, (const void*)&segment->snapshot, sizeof(ScoreboardSnapshot));
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (segment->sequence.load(std::memory_order_relaxed) == before)
+        {
+            return ScoreboardRead::Copied;
+        }
+    }
+
+    return ScoreboardRead::Busy;
+}
+
+/// Publish a snapshot to a segment mapped read-write; only one process may write to a segment
+inline void writeScoreboard(ScoreboardSegment* segment, const ScoreboardSnapshot &snapshot)
+{
+    uint64_t sequence = segment->sequence.load(std::memory_order_relaxed);
+
+    segment->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    memcpy((void*)&segment->snapshot, &snapshot, sizeof(ScoreboardSnapshot));
+
+    segment->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+#endif
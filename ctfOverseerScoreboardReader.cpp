@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2019 Vladimir "allejo" Jimenez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Prints the shared memory scoreboard published by the plug-in's `scoreboard_shm_name` option.
+//
+// Usage: ctfOverseerScoreboardReader [-w seconds] <shared memory name>
+//
+// With -w, the scoreboard is printed again every time a new snapshot is published, checking for one every `seconds`.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ctfOverseerScoreboard.h"
+
+const char* const TEAM_NAMES[SCOREBOARD_TEAMS] = {"Rogue", "Red", "Green", "Blue", "Purple"};
+
+static void print(const ScoreboardSnapshot &snapshot)
+{
+    double now = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+    double age = std::max(0.0, now - snapshot.wallTime);
+
+    printf("Snapshot from %.1f seconds ago (server time %.1f)\n", age, snapshot.serverTime);
+    printf("  %-8s %6s %10s %10s %10s %10s\n", "team", "size", "cooldown", "captures", "unfair", "self");
+
+    for (int team = 0; team < SCOREBOARD_TEAMS; team++)
+    {
+        printf("  %-8s %6d %9.1fs %10llu %10llu %10llu\n", TEAM_NAMES[team], snapshot.teamSize[team],
+            std::max(0.0, snapshot.cooldownRemaining[team] - age), (unsigned long long)snapshot.captures[team],
+            (unsigned long long)snapshot.unfairCaptures[team], (unsigned long long)snapshot.selfCaptures[team]);
+    }
+
+    printf("  Capture bonus now / locked in, by capping team (rows) and capped team (columns)\n");
+    printf("  %-8s", "");
+
+    for (int capped = 1; capped < SCOREBOARD_TEAMS; capped++)
+    {
+        printf(" %13s", TEAM_NAMES[capped]);
+    }
+
+    printf("\n");
+
+    for (int capping = 1; capping < SCOREBOARD_TEAMS; capping++)
+    {
+        printf("  %-8s", TEAM_NAMES[capping]);
+
+        for (int capped = 1; capped < SCOREBOARD_TEAMS; capped++)
+        {
+            printf(" %6d / %4d", snapshot.bonus[capping][capped], snapshot.capBonus[capping][capped]);
+        }
+
+        printf("\n");
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    double interval = 0;
+    std::string name;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+        {
+            interval = atof(argv[++i]);
+        }
+        else
+        {
+            name = argv[i];
+        }
+    }
+
+    if (name.empty())
+    {
+        fprintf(stderr, "usage: %s [-w seconds] <shared memory name>\n", argv[0]);
+        return 1;
+    }
+
+    if (name[0] != '/')
+    {
+        name.insert(0, "/");
+    }
+
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+
+    if (fd < 0)
+    {
+        fprintf(stderr, "error: cannot open shared memory %s; is the plug-in loaded with scoreboard_shm_name set?\n", name.c_str());
+        return 1;
+    }
+
+    struct stat info;
+
+    // Touching a mapping past the end of a shorter object raises SIGBUS instead of failing
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(ScoreboardSegment))
+    {
+        fprintf(stderr, "error: %s is not a scoreboard this reader understands\n", name.c_str());
+        close(fd);
+        return 1;
+    }
+
+    void* mapping = mmap(NULL, sizeof(ScoreboardSegment), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED)
+    {
+        fprintf(stderr, "error: cannot map shared memory %s\n", name.c_str());
+        return 1;
+    }
+
+    const ScoreboardSegment* segment = (const ScoreboardSegment*)mapping;
+
+    if (segment->magic != SCOREBOARD_MAGIC || segment->version != SCOREBOARD_VERSION || segment->size != sizeof(ScoreboardSegment))
+    {
+        fprintf(stderr, "error: %s is not a scoreboard this reader understands\n", name.c_str());
+        return 1;
+    }
+
+    uint64_t lastSequence = 0;
+
+    do
+    {
+        uint64_t sequence = segment->sequence.load(std::memory_order_acquire);
+        ScoreboardSnapshot snapshot;
+        ScoreboardRead result = ScoreboardRead::NothingPublished;
+
+        if (sequence != lastSequence)
+        {
+            result = readScoreboard(segment, snapshot);
+
+            // Give a writer that keeps winning the race a few more chances before giving up on a one-off read
+            for (int retry = 0; result == ScoreboardRead::Busy && interval <= 0 && retry < 10; retry++)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                result = readScoreboard(segment, snapshot);
+            }
+        }
+
+        if (result == ScoreboardRead::Copied)
+        {
+            lastSequence = sequence;
+            print(snapshot);
+        }
+        else if (interval <= 0)
+        {
+            printf(result == ScoreboardRead::Busy ? "The scoreboard was being written every time it was read; try again\n" : "Nothing has been published yet\n");
+        }
+
+        if (interval > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::duration<double>(interval));
+        }
+    }
+    while (interval > 0);
+
+    munmap(mapping, sizeof(ScoreboardSegment));
+
+    return 0;
+}
@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2019 Vladimir "allejo" Jimenez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CTFOVERSEER_SCORING_H
+#define CTFOVERSEER_SCORING_H
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <stddef.h>
+
+/**
+ * The capture scoring rules, free of any dependency on bzfs so that the plug-in and ctfOverseerSimulator score
+ * captures the same way.
+ *
+ * A capture is scored in two steps. When an enemy grabs a team flag, the bonus for the current team sizes is locked in
+ * for the grabbing team, unless the flag was dropped by an enemy less than RECALC_INTERVAL seconds earlier. When the
+ * flag is captured, the capture is fair if the bonus for the team sizes at that moment is still positive; a fair
+ * capture awards the locked-in bonus and an unfair one takes it away. Self-captures always cost a penalty.
+ */
+
+const int RECALC_INTERVAL = 20; /// The number of seconds between a flag drop and point bonus point recalculation
+
+// Scoring table sizing
+const int MAX_TEAM_SIZE = 200; /// bzfs supports at most 200 players, so no team can be larger than this
+const int SCORING_TABLE_WIDTH = MAX_TEAM_SIZE + 1;
+
+/// The coefficients of the capture scoring formula, which may be overridden in the configuration file
+struct ScoringPolicy
+{
+    int losingTeamWeight; /// Points awarded per player on the team whose flag was captured
+    int teamDifferenceWeight; /// Points awarded per player the capping team is outnumbered by (or taken away if it outnumbers)
+    double fairRatio; /// When the capping team is larger, a capture is worth nothing if capped/capping is at or below this
+    int selfCapMultiplier; /// The penalty multiplier for self-caps; this number times the current team size
+
+    constexpr int score(int cappingTeamSize, int losingTeamSize) const
+    {
+        return (cappingTeamSize == 0) ? 0 :
+            (cappingTeamSize > losingTeamSize && (double)losingTeamSize / (double)cappingTeamSize <= fairRatio) ? 0 :
+            (losingTeamWeight * losingTeamSize + teamDifferenceWeight * (losingTeamSize - cappingTeamSize));
+    }
+
+    bool operator==(const ScoringPolicy &rhs) const
+    {
+        return losingTeamWeight == rhs.losingTeamWeight && teamDifferenceWeight == rhs.teamDifferenceWeight &&
+            fairRatio == rhs.fairRatio && selfCapMultiplier == rhs.selfCapMultiplier;
+    }
+};
+
+constexpr ScoringPolicy DEFAULT_SCORING_POLICY = {3, 8, 0.8, 5};
+
+/// The score of a capture for every (capping team size, capped team size) pair, indexed by [capping * width + capped]
+struct ScoringTable
+{
+    int points[SCORING_TABLE_WIDTH * SCORING_TABLE_WIDTH];
+};
+
+template <size_t... I>
+struct IndexSequence {};
+
+template <class A, class B>
+struct ConcatIndexSequence;
+
+template <size_t... A, size_t... B>
+struct ConcatIndexSequence<IndexSequence<A...>, IndexSequence<B...>>
+{
+    typedef IndexSequence<A..., (sizeof...(A) + B)...> type;
+};
+
+/// A C++11 stand-in for std::make_index_sequence that only recurses log(N) deep
+template <size_t N>
+struct MakeIndexSequence
+{
+    typedef typename ConcatIndexSequence<typename MakeIndexSequence<N / 2>::type, typename MakeIndexSequence<N - N / 2>::type>::type type;
+};
+
+template <>
+struct MakeIndexSequence<0>
+{
+    typedef IndexSequence<> type;
+};
+
+template <>
+struct MakeIndexSequence<1>
+{
+    typedef IndexSequence<0> type;
+};
+
+template <size_t... I>
+constexpr ScoringTable buildScoringTable(ScoringPolicy policy, IndexSequence<I...>)
+{
+    return ScoringTable{{ policy.score(I / SCORING_TABLE_WIDTH, I % SCORING_TABLE_WIDTH)... }};
+}
+
+/// The table for the default policy is generated at compile time; only overridden policies are built at runtime
+constexpr ScoringTable DEFAULT_SCORING_TABLE = buildScoringTable(DEFAULT_SCORING_POLICY, MakeIndexSequence<SCORING_TABLE_WIDTH * SCORING_TABLE_WIDTH>::type());
+
+static_assert(DEFAULT_SCORING_TABLE.points[5 * SCORING_TABLE_WIDTH + 5] == 15, "Default scoring table was not generated correctly");
+
+/// A scoring policy along with its precomputed table so scoring a capture is a table read
+class CaptureScoring
+{
+public:
+    CaptureScoring();
+
+    void setPolicy(const ScoringPolicy &policy);
+    const ScoringPolicy& policy() const;
+
+    int points(int cappingTeamSize, int losingTeamSize) const
+    {
+        if ((unsigned)cappingTeamSize < (unsigned)SCORING_TABLE_WIDTH && (unsigned)losingTeamSize < (unsigned)SCORING_TABLE_WIDTH)
+        {
+            return table->points[cappingTeamSize * SCORING_TABLE_WIDTH + losingTeamSize];
+        }
+
+        return currentPolicy.score(cappingTeamSize, losingTeamSize);
+    }
+
+private:
+    ScoringPolicy currentPolicy;
+    std::shared_ptr<const ScoringTable> customTable; /// Only set when the policy differs from the default
+    const ScoringTable* table;
+};
+
+inline CaptureScoring::CaptureScoring() :
+    currentPolicy(DEFAULT_SCORING_POLICY),
+    table(&DEFAULT_SCORING_TABLE)
+{
+}
+
+inline void CaptureScoring::setPolicy(const ScoringPolicy &policy)
+{
+    currentPolicy = policy;
+
+    if (policy == DEFAULT_SCORING_POLICY)
+    {
+        customTable.reset();
+        table = &DEFAULT_SCORING_TABLE;
+
+        return;
+    }
+
+    std::shared_ptr<ScoringTable> newTable = std::make_shared<ScoringTable>();
+
+    for (int capping = 0; capping < SCORING_TABLE_WIDTH; capping++)
+    {
+        for (int capped = 0; capped < SCORING_TABLE_WIDTH; capped++)
+        {
+            newTable->points[capping * SCORING_TABLE_WIDTH + capped] = policy.score(capping, capped);
+        }
+    }
+
+    customTable = newTable;
+    table = customTable.get();
+}
+
+inline const ScoringPolicy& CaptureScoring::policy() const
+{
+    return currentPolicy;
+}
+
+/// Whether a capture should be let through, given the BZDB settings that may disallow it
+enum class CaptureDecision
+{
+    Allowed,
+    DeniedSelfCap,
+    DeniedUnfair,
+};
+
+inline CaptureDecision decideCapture(bool isSelfCap, bool isFair, bool disallowSelfCap, bool disallowUnfairCap)
+{
+    if (disallowSelfCap && isSelfCap)
+    {
+        return CaptureDecision::DeniedSelfCap;
+    }
+
+    if (disallowUnfairCap && !isFair)
+    {
+        return CaptureDecision::DeniedUnfair;
+    }
+
+    return CaptureDecision::Allowed;
+}
+
+/// The bonus a capture is worth with the given team sizes, limited to `_maxCapBonus`
+inline int captureBonus(const CaptureScoring &scoring, int cappingTeamSize, int cappedTeamSize, int maxCapBonus)
+{
+    return std::min(maxCapBonus, scoring.points(cappingTeamSize, cappedTeamSize));
+}
+
+/// A capture is fair while the bonus for the current team sizes is positive
+inline bool isFairBonus(int bonus)
+{
+    return bonus > 0;
+}
+
+/// The points awarded for a capture; negative for penalties on self or unfair captures
+inline int awardedPoints(const ScoringPolicy &policy, bool isSelfCap, bool isFair, int lockedBonus, int cappedTeamSize)
+{
+    if (isSelfCap)
+    {
+        return -1 * policy.selfCapMultiplier * cappedTeamSize;
+    }
+
+    return isFair ? abs(lockedBonus) : -1 * abs(lockedBonus);
+}
+
+#endif
@@ -0,0 +1,741 @@
+/*
+ * Copyright (C) 2019 Vladimir "allejo" Jimenez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Plays synthetic CTF matches under one or more scoring policies and reports how points and penalties are distributed,
+// so a change to the scoring formula or `_maxCapBonus` can be evaluated before it's used on a live map. Scoring goes
+// through the same code as the plug-in (ctfOverseerScoring.h). Matches are split between the cores with a work-stealing
+// thread pool, and every policy plays the exact same matches so differences between them aren't noise.
+//
+// Usage: ctfOverseerSimulator [-j threads] [-n matches] [-t teams] [-d minutes] [-g grab delay] [-r seed] [-u] [-s]
+//                             [-p losing,difference,fairRatio,selfCapMultiplier[,maxCapBonus]]...
+//
+// -u disallows unfair captures and -s allows self captures, like `_disallowUnfairCap` and `_disallowSelfCap`. Without
+// any -p the default policy is simulated.
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ctfOverseerScoring.h"
+
+const int MAX_TEAMS = 4; /// Red, green, blue and purple
+
+// Match model; every rate is per simulated second
+const double JOIN_RATE = 0.05;          /// Chance a player joins the match
+const double LEAVE_RATE = 1.0 / 600;    /// Chance each player leaves; an average stay of 10 minutes
+const double AUTO_TEAM_CHANCE = 0.7;    /// Chance a joining player is put on the smallest team instead of picking one
+const double GRAB_RATE = 0.01;          /// Chance each enemy player grabs an available team flag
+const double DEFEND_RATE = 0.006;       /// Chance each defender kills the player carrying their flag, dropping it
+const double CAPTURE_RATE = 0.03;       /// Chance a carried flag is brought home
+const double SELF_CAP_RATE = 0.00005;   /// Chance each player attempts to capture their own team flag
+const int INITIAL_TEAM_SIZE = 8;        /// Teams start with between 1 and this many players
+const int DEFAULT_MAX_CAP_BONUS = 9999; /// The `_maxCapBonus` default
+const int DEFAULT_GRAB_DELAY = 20;      /// The `_delayTeamFlagGrab` default
+
+// Reporting
+const int POINTS_RANGE = 4096;   /// Histograms cover [-POINTS_RANGE, POINTS_RANGE]; anything past that is clamped
+const uint64_t MATCH_GRAIN = 64; /// Ranges of matches this small are played instead of being split further
+
+/// The policy and BZDB settings a set of matches is played with
+struct SimulatedPolicy
+{
+    std::string label;
+    ScoringPolicy policy;
+    int maxCapBonus;
+    CaptureScoring scoring;
+};
+
+/// Settings shared by every policy
+struct MatchSettings
+{
+    int teams = 2;
+    int seconds = 30 * 60;
+    int grabDelay = DEFAULT_GRAB_DELAY;
+    bool disallowSelfCap = true;
+    bool disallowUnfairCap = false;
+};
+
+/// SplitMix64; fast, and more than random enough for deciding who grabs a flag
+struct Random
+{
+    uint64_t state;
+
+    explicit Random(uint64_t seed) : state(seed) {}
+
+    uint64_t next()
+    {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+        return z ^ (z >> 31);
+    }
+
+    double uniform()
+    {
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    int below(int bound)
+    {
+        return (int)(uniform() * bound);
+    }
+};
+
+class Histogram
+{
+public:
+    Histogram() : counts(2 * POINTS_RANGE + 1, 0), samples(0) {}
+
+    void add(int64_t value)
+    {
+        counts[std::max<int64_t>(-POINTS_RANGE, std::min<int64_t>(POINTS_RANGE, value)) + POINTS_RANGE]++;
+        samples++;
+    }
+
+    void merge(const Histogram &other)
+    {
+        for (size_t i = 0; i < counts.size(); i++)
+        {
+            counts[i] += other.counts[i];
+        }
+
+        samples += other.samples;
+    }
+
+    int percentile(double fraction) const
+    {
+        uint64_t rank = (uint64_t)(fraction * samples);
+        uint64_t seen = 0;
+
+        for (size_t i = 0; i < counts.size(); i++)
+        {
+            seen += counts[i];
+
+            if (seen > rank)
+            {
+                return (int)i - POINTS_RANGE;
+            }
+        }
+
+        return POINTS_RANGE;
+    }
+
+    uint64_t size() const
+    {
+        return samples;
+    }
+
+private:
+    std::vector<uint64_t> counts;
+    uint64_t samples;
+};
+
+struct Summary
+{
+    uint64_t matches = 0;
+
+    uint64_t attempts = 0;
+    uint64_t deniedSelfCaps = 0;
+    uint64_t deniedUnfairCaps = 0;
+
+    uint64_t captures = 0;
+    uint64_t fairCaptures = 0;
+    uint64_t unfairCaptures = 0;
+    uint64_t selfCaptures = 0;
+    int64_t pointsAwarded = 0;
+    int64_t unfairPenalties = 0;
+    int64_t selfCapPenalties = 0;
+
+    Histogram pointsPerCapture;
+    Histogram pointsPerMatch; /// The net points awarded to every team in a match
+
+    void merge(const Summary &other);
+};
+
+void Summary::merge(const Summary &other)
+{
+    matches += other.matches;
+    attempts += other.attempts;
+    deniedSelfCaps += other.deniedSelfCaps;
+    deniedUnfairCaps += other.deniedUnfairCaps;
+    captures += other.captures;
+    fairCaptures += other.fairCaptures;
+    unfairCaptures += other.unfairCaptures;
+    selfCaptures += other.selfCaptures;
+    pointsAwarded += other.pointsAwarded;
+    unfairPenalties += other.unfairPenalties;
+    selfCapPenalties += other.selfCapPenalties;
+
+    pointsPerCapture.merge(other.pointsPerCapture);
+    pointsPerMatch.merge(other.pointsPerMatch);
+}
+
+/// A fixed set of workers, each with its own deque of match ranges. A worker keeps splitting the range it's about to
+/// play in half, pushing the far half onto the back of its own deque; idle workers steal from the front of someone
+/// else's deque, where the largest ranges are. Workers with nothing to steal sleep until a range is pushed or every match
+/// has been played.
+class WorkStealingPool
+{
+public:
+    typedef std::function<void(unsigned worker, uint64_t begin, uint64_t end)> Body;
+
+    explicit WorkStealingPool(unsigned workers);
+
+    void run(uint64_t count, const Body &body);
+
+private:
+    struct Range
+    {
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    struct WorkerQueue
+    {
+        std::mutex lock;
+        std::deque<Range> ranges;
+    };
+
+    void work(unsigned worker, const Body &body);
+    void push(unsigned worker, const Range &range);
+    bool popLocal(unsigned worker, Range &range);
+    bool steal(unsigned worker, Range &range);
+    void park();
+    void wakeIdle(bool everyone);
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::atomic<uint64_t> remaining; /// Matches not played yet; workers stop once this reaches zero
+    std::atomic<uint64_t> queued;    /// Ranges waiting in any worker's deque
+    std::atomic<unsigned> parked;    /// Workers waiting on `idle` for a range to steal
+    std::mutex idleLock;
+    std::condition_variable idle;
+};
+
+WorkStealingPool::WorkStealingPool(unsigned workers) :
+    remaining(0),
+    queued(0),
+    parked(0)
+{
+    for (unsigned i = 0; i < workers; i++)
+    {
+        queues.emplace_back(new WorkerQueue());
+    }
+}
+
+void WorkStealingPool::run(uint64_t count, const Body &body)
+{
+    remaining = count;
+    queued = 1;
+    queues[0]->ranges.push_back(Range{0, count});
+
+    std::vector<std::thread> threads;
+
+    for (unsigned worker = 1; worker < queues.size(); worker++)
+    {
+        threads.emplace_back(&WorkStealingPool::work, this, worker, std::cref(body));
+    }
+
+    work(0, body);
+
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+}
+
+void WorkStealingPool::work(unsigned worker, const Body &body)
+{
+    while (remaining.load(std::memory_order_acquire) > 0)
+    {
+        Range range;
+
+        if (!popLocal(worker, range) && !steal(worker, range))
+        {
+            park();
+            continue;
+        }
+
+        while (range.end - range.begin > MATCH_GRAIN)
+        {
+            uint64_t middle = range.begin + (range.end - range.begin) / 2;
+
+            push(worker, Range{middle, range.end});
+            range.end = middle;
+        }
+
+        body(worker, range.begin, range.end);
+
+        if (remaining.fetch_sub(range.end - range.begin, std::memory_order_acq_rel) == range.end - range.begin)
+        {
+            wakeIdle(true);
+        }
+    }
+}
+
+void WorkStealingPool::push(unsigned worker, const Range &range)
+{
+    {
+        std::lock_guard<std::mutex> guard(queues[worker]->lock);
+        queues[worker]->ranges.push_back(range);
+    }
+
+    queued.fetch_add(1);
+
+    if (parked.load() > 0)
+    {
+        wakeIdle(false);
+    }
+}
+
+bool WorkStealingPool::popLocal(unsigned worker, Range &range)
+{
+    std::lock_guard<std::mutex> guard(queues[worker]->lock);
+
+    if (queues[worker]->ranges.empty())
+    {
+        return false;
+    }
+
+    range = queues[worker]->ranges.back();
+    queues[worker]->ranges.pop_back();
+    queued.fetch_sub(1);
+
+    return true;
+}
+
+bool WorkStealingPool::steal(unsigned worker, Range &range)
+{
+    for (size_t offset = 1; offset < queues.size(); offset++)
+    {
+        WorkerQueue &victim = *queues[(worker + offset) % queues.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+
+        if (!victim.ranges.empty())
+        {
+            range = victim.ranges.front();
+            victim.ranges.pop_front();
+            queued.fetch_sub(1);
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void WorkStealingPool::park()
+{
+    std::unique_lock<std::mutex> lock(idleLock);
+
+    // `parked` is raised before `queued` is checked, and push() raises `queued` before checking `parked`, so either this
+    // worker sees the new range or the pusher sees it waiting
+    parked.fetch_add(1);
+    idle.wait(lock, [this]() { return remaining.load() == 0 || queued.load() > 0; });
+    parked.fetch_sub(1);
+}
+
+void WorkStealingPool::wakeIdle(bool everyone)
+{
+    // Taking the lock orders this wakeup after any worker that's between checking the predicate and waiting
+    {
+        std::lock_guard<std::mutex> guard(idleLock);
+    }
+
+    if (everyone)
+    {
+        idle.notify_all();
+    }
+    else
+    {
+        idle.notify_one();
+    }
+}
+
+/// Pick a team with a chance proportional to its size, leaving out `exclude`
+static int pickTeam(Random &random, const int* sizes, int teams, int exclude, int total)
+{
+    int pick = random.below(total);
+
+    for (int team = 0; team < teams; team++)
+    {
+        if (team == exclude)
+        {
+            continue;
+        }
+
+        if (pick < sizes[team])
+        {
+            return team;
+        }
+
+        pick -= sizes[team];
+    }
+
+    return -1;
+}
+
+/// Play one match second by second, following the same grab, drop and capture rules as the plug-in
+static void playMatch(const SimulatedPolicy &sim, const MatchSettings &settings, uint64_t seed, Summary &summary)
+{
+    struct Flag
+    {
+        int carrier = -1;                 /// The team carrying the flag, or -1
+        int droppedAt = -RECALC_INTERVAL; /// When an enemy last dropped it
+        int cooldownEnd = 0;              /// Enemies may not grab it before this
+    };
+
+    Random random(seed);
+    Flag flags[MAX_TEAMS];
+    int sizes[MAX_TEAMS] = {};
+    int lockedBonus[MAX_TEAMS][MAX_TEAMS] = {}; /// By [capping][capped], like StateStore::capBonus
+    int total = 0;
+    int64_t matchPoints = 0;
+
+    for (int team = 0; team < settings.teams; team++)
+    {
+        sizes[team] = 1 + random.below(INITIAL_TEAM_SIZE);
+        total += sizes[team];
+    }
+
+    auto score = [&](int capping, int capped) {
+        return captureBonus(sim.scoring, sizes[capping], sizes[capped], sim.maxCapBonus);
+    };
+
+    for (int now = 0; now < settings.seconds; now++)
+    {
+        // Roster churn
+        if (total > 0 && random.uniform() < total * LEAVE_RATE)
+        {
+            int team = pickTeam(random, sizes, settings.teams, -1, total);
+
+            sizes[team]--;
+            total--;
+
+            for (int flag = 0; flag < settings.teams && sizes[team] == 0; flag++)
+            {
+                if (flags[flag].carrier == team)
+                {
+                    flags[flag].carrier = -1;
+                    flags[flag].droppedAt = now;
+                }
+            }
+        }
+
+        if (total < MAX_TEAM_SIZE && random.uniform() < JOIN_RATE)
+        {
+            int team = random.below(settings.teams);
+
+            if (random.uniform() < AUTO_TEAM_CHANCE)
+            {
+                team = (int)(std::min_element(sizes, sizes + settings.teams) - sizes);
+            }
+
+            sizes[team]++;
+            total++;
+        }
+
+        for (int team = 0; team < settings.teams; team++)
+        {
+            Flag &flag = flags[team];
+
+            if (flag.carrier >= 0)
+            {
+                int capping = flag.carrier;
+
+                if (random.uniform() < DEFEND_RATE * sizes[team])
+                {
+                    flag.carrier = -1;
+                    flag.droppedAt = now;
+                }
+                else if (random.uniform() < CAPTURE_RATE)
+                {
+                    bool isFair = isFairBonus(score(capping, team));
+                    CaptureDecision decision = decideCapture(false, isFair, settings.disallowSelfCap, settings.disallowUnfairCap);
+
+                    summary.attempts++;
+                    flag.carrier = -1;
+
+                    if (decision == CaptureDecision::DeniedUnfair)
+                    {
+                        // The flag is sent to a safety zone, which counts as a drop
+                        summary.deniedUnfairCaps++;
+                        flag.droppedAt = now;
+                    }
+                    else
+                    {
+                        int points = awardedPoints(sim.policy, false, isFair, lockedBonus[capping][team], sizes[team]);
+
+                        summary.captures++;
+                        summary.pointsPerCapture.add(points);
+                        matchPoints += points;
+                        flag.cooldownEnd = now + std::max(0, settings.grabDelay);
+
+                        if (isFair)
+                        {
+                            summary.fairCaptures++;
+                            summary.pointsAwarded += points;
+                        }
+                        else
+                        {
+                            summary.unfairCaptures++;
+                            summary.unfairPenalties -= points;
+                        }
+                    }
+                }
+            }
+            else if (now >= flag.cooldownEnd)
+            {
+                int enemies = total - sizes[team];
+
+                if (enemies > 0 && random.uniform() < GRAB_RATE * enemies)
+                {
+                    int capping = pickTeam(random, sizes, settings.teams, team, enemies);
+
+                    if (now - flag.droppedAt >= RECALC_INTERVAL)
+                    {
+                        lockedBonus[capping][team] = score(capping, team);
+                    }
+
+                    flag.carrier = capping;
+                }
+            }
+
+            if (sizes[team] > 0 && random.uniform() < SELF_CAP_RATE * sizes[team])
+            {
+                summary.attempts++;
+
+                if (decideCapture(true, true, settings.disallowSelfCap, settings.disallowUnfairCap) == CaptureDecision::DeniedSelfCap)
+                {
+                    summary.deniedSelfCaps++;
+                }
+                else
+                {
+                    int points = awardedPoints(sim.policy, true, true, 0, sizes[team]);
+
+                    summary.captures++;
+                    summary.selfCaptures++;
+                    summary.selfCapPenalties -= points;
+                    summary.pointsPerCapture.add(points);
+                    matchPoints += points;
+                }
+            }
+        }
+    }
+
+    summary.matches++;
+    summary.pointsPerMatch.add(matchPoints);
+}
+
+static bool parsePolicy(const char* spec, SimulatedPolicy &sim)
+{
+    ScoringPolicy policy = DEFAULT_SCORING_POLICY;
+    int maxCapBonus = DEFAULT_MAX_CAP_BONUS;
+
+    int fields = sscanf(spec, "%d,%d,%lf,%d,%d", &policy.losingTeamWeight, &policy.teamDifferenceWeight, &policy.fairRatio,
+        &policy.selfCapMultiplier, &maxCapBonus);
+
+    if (fields < 4 || policy.fairRatio < 0 || maxCapBonus < 0)
+    {
+        return false;
+    }
+
+    sim.label = spec;
+    sim.policy = policy;
+    sim.maxCapBonus = maxCapBonus;
+    sim.scoring.setPolicy(policy);
+
+    return true;
+}
+
+static double percent(uint64_t part, uint64_t whole)
+{
+    return whole ? 100.0 * part / whole : 0.0;
+}
+
+static double perMatch(int64_t value, uint64_t matches)
+{
+    return matches ? (double)value / matches : 0.0;
+}
+
+static void printPercentiles(const char* label, const Histogram &histogram)
+{
+    printf("  %-22s p1 %+6d  p10 %+6d  p50 %+6d  p90 %+6d  p99 %+6d\n", label, histogram.percentile(0.01),
+        histogram.percentile(0.10), histogram.percentile(0.50), histogram.percentile(0.90), histogram.percentile(0.99));
+}
+
+static void report(const SimulatedPolicy &sim, const Summary &summary)
+{
+    uint64_t unfairAttempts = summary.unfairCaptures + summary.deniedUnfairCaps;
+    uint64_t teamAttempts = summary.attempts - summary.selfCaptures - summary.deniedSelfCaps;
+
+    printf("Policy %s: %d * losing + %d * (losing - capping), fair ratio %.2f, self cap x%d, max bonus %d\n", sim.label.c_str(),
+        sim.policy.losingTeamWeight, sim.policy.teamDifferenceWeight, sim.policy.fairRatio, sim.policy.selfCapMultiplier,
+        sim.maxCapBonus);
+    printf("  Matches:               %llu\n", (unsigned long long)summary.matches);
+    printf("  Capture attempts:      %llu (%.2f per match)\n", (unsigned long long)summary.attempts, perMatch(summary.attempts, summary.matches));
+    printf("    Unfair:              %llu (%.1f%% of team flag attempts)\n", (unsigned long long)unfairAttempts, percent(unfairAttempts, teamAttempts));
+    printf("    Denied self caps:    %llu\n", (unsigned long long)summary.deniedSelfCaps);
+    printf("    Denied unfair caps:  %llu\n", (unsigned long long)summary.deniedUnfairCaps);
+    printf("  Captures:              %llu\n", (unsigned long long)summary.captures);
+    printf("    Fair:                %llu (%.1f%%)\n", (unsigned long long)summary.fairCaptures, percent(summary.fairCaptures, summary.captures));
+    printf("    Unfair:              %llu (%.1f%%)\n", (unsigned long long)summary.unfairCaptures, percent(summary.unfairCaptures, summary.captures));
+    printf("    Self:                %llu (%.1f%%)\n", (unsigned long long)summary.selfCaptures, percent(summary.selfCaptures, summary.captures));
+    printf("  Points awarded:        %lld (%.1f per match, %.1f per fair capture)\n", (long long)summary.pointsAwarded,
+        perMatch(summary.pointsAwarded, summary.matches), perMatch(summary.pointsAwarded, summary.fairCaptures));
+    printf("  Unfair cap penalties:  %lld (%.1f per unfair capture)\n", (long long)summary.unfairPenalties,
+        perMatch(summary.unfairPenalties, summary.unfairCaptures));
+    printf("  Self cap penalties:    %lld (%.1f per self capture)\n", (long long)summary.selfCapPenalties,
+        perMatch(summary.selfCapPenalties, summary.selfCaptures));
+
+    if (summary.pointsPerCapture.size() > 0)
+    {
+        printPercentiles("Points per capture", summary.pointsPerCapture);
+    }
+
+    printPercentiles("Net points per match", summary.pointsPerMatch);
+}
+
+static void usage(const char* program)
+{
+    fprintf(stderr, "usage: %s [-j threads] [-n matches] [-t teams] [-d minutes] [-g grab delay] [-r seed] [-u] [-s]\n", program);
+    fprintf(stderr, "       %*s [-p losing,difference,fairRatio,selfCapMultiplier[,maxCapBonus]]...\n", (int)strlen(program), "");
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    uint64_t matches = 100000;
+    uint64_t seed = 1;
+    MatchSettings settings;
+    std::vector<std::unique_ptr<SimulatedPolicy>> policies;
+
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+
+        if (strcmp(argv[i], "-j") == 0 && hasValue)
+        {
+            threads = std::max(1, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "-n") == 0 && hasValue)
+        {
+            matches = strtoull(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "-t") == 0 && hasValue)
+        {
+            settings.teams = std::max(2, std::min(MAX_TEAMS, atoi(argv[++i])));
+        }
+        else if (strcmp(argv[i], "-d") == 0 && hasValue)
+        {
+            settings.seconds = std::max(1, atoi(argv[++i])) * 60;
+        }
+        else if (strcmp(argv[i], "-g") == 0 && hasValue)
+        {
+            settings.grabDelay = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-r") == 0 && hasValue)
+        {
+            seed = strtoull(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "-u") == 0)
+        {
+            settings.disallowUnfairCap = true;
+        }
+        else if (strcmp(argv[i], "-s") == 0)
+        {
+            settings.disallowSelfCap = false;
+        }
+        else if (strcmp(argv[i], "-p") == 0 && hasValue)
+        {
+            std::unique_ptr<SimulatedPolicy> sim(new SimulatedPolicy());
+
+            if (!parsePolicy(argv[++i], *sim))
+            {
+                fprintf(stderr, "error: invalid policy: %s\n", argv[i]);
+                return 1;
+            }
+
+            policies.push_back(std::move(sim));
+        }
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (policies.empty())
+    {
+        std::unique_ptr<SimulatedPolicy> sim(new SimulatedPolicy());
+        sim->label = "default";
+        sim->policy = DEFAULT_SCORING_POLICY;
+        sim->maxCapBonus = DEFAULT_MAX_CAP_BONUS;
+
+        policies.push_back(std::move(sim));
+    }
+
+    printf("Simulating %llu matches of %d minutes with %d teams on %u threads\n\n", (unsigned long long)matches,
+        settings.seconds / 60, settings.teams, threads);
+
+    // partials[worker][policy]
+    std::vector<std::vector<Summary>> partials(threads, std::vector<Summary>(policies.size()));
+    WorkStealingPool pool(threads);
+
+    pool.run(matches, [&](unsigned worker, uint64_t begin, uint64_t end) {
+        for (uint64_t match = begin; match < end; match++)
+        {
+            // Seed from the match number alone so the result doesn't depend on the thread count
+            uint64_t matchSeed = Random(seed ^ (match * 0xD1B54A32D192ED03ULL)).next();
+
+            for (size_t p = 0; p < policies.size(); p++)
+            {
+                playMatch(*policies[p], settings, matchSeed, partials[worker][p]);
+            }
+        }
+    });
+
+    for (size_t p = 0; p < policies.size(); p++)
+    {
+        Summary total;
+
+        for (unsigned worker = 0; worker < threads; worker++)
+        {
+            total.merge(partials[worker][p]);
+        }
+
+        report(*policies[p], total);
+        printf("\n");
+    }
+
+    return 0;
+}
@@ -0,0 +1,712 @@
+/*
+ * Copyright (C) 2019 Vladimir "allejo" Jimenez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <vector>
+
+#include "ctfOverseerStubs.h"
+
+#include "bzfsAPI.h"
+#include "plugin_utils.h"
+
+struct StubPlayer
+{
+    bool active;
+    bz_eTeamType team;
+    std::string callsign;
+    int flagID;
+    int wins;
+    int losses;
+};
+
+struct StubFlag
+{
+    std::string type;
+    float position[3];
+};
+
+struct StubServer
+{
+    double currentTime = 0;
+    int debugLevel = 0;
+    uint64_t messagesSent = 0;
+
+    std::vector<StubPlayer> players;
+    std::vector<StubFlag> flags;
+    std::map<std::string, std::string> bzdb;
+    std::map<std::string, std::string> clipFields;
+    std::map<std::string, bz_CustomSlashCommandHandler*> slashCommands;
+
+    bz_Plugin* plugin = NULL;
+    char formatBuffer[2048];
+};
+
+static StubServer server;
+
+static StubPlayer* findPlayer(int playerID)
+{
+    if (playerID < 0 || playerID >= (int)server.players.size() || !server.players[playerID].active)
+    {
+        return NULL;
+    }
+
+    return &server.players[playerID];
+}
+
+//
+// Stub controls
+//
+
+void bzfsStub::reset()
+{
+    server.currentTime = 0;
+    server.debugLevel = 0;
+    server.messagesSent = 0;
+    server.players.clear();
+    server.flags.clear();
+    server.bzdb.clear();
+    server.clipFields.clear();
+    server.slashCommands.clear();
+    server.plugin = NULL;
+}
+
+void bzfsStub::setCurrentTime(double time)
+{
+    server.currentTime = time;
+}
+
+void bzfsStub::advanceTime(double seconds)
+{
+    server.currentTime += seconds;
+}
+
+int bzfsStub::addPlayer(bz_eTeamType team, const char* callsign)
+{
+    for (size_t i = 0; i < server.players.size(); i++)
+    {
+        if (!server.players[i].active)
+        {
+            server.players[i] = {true, team, callsign, -1, 0, 0};
+            return (int)i;
+        }
+    }
+
+    // bzfs reserves the highest player IDs for the server itself
+    if (server.players.size() >= 200)
+    {
+        return -1;
+    }
+
+    server.players.push_back({true, team, callsign, -1, 0, 0});
+
+    return (int)server.players.size() - 1;
+}
+
+void bzfsStub::removePlayer(int playerID)
+{
+    if (StubPlayer* player = findPlayer(playerID))
+    {
+        player->active = false;
+    }
+}
+
+void bzfsStub::setPlayerTeam(int playerID, bz_eTeamType team)
+{
+    if (StubPlayer* player = findPlayer(playerID))
+    {
+        player->team = team;
+    }
+}
+
+int bzfsStub::addFlag(const char* flagType)
+{
+    server.flags.push_back({flagType, {0, 0, 0}});
+
+    return (int)server.flags.size() - 1;
+}
+
+void bzfsStub::setPlayerFlag(int playerID, int flagID)
+{
+    if (StubPlayer* player = findPlayer(playerID))
+    {
+        player->flagID = flagID;
+    }
+}
+
+void bzfsStub::setBZDB(const std::string &name, const std::string &value)
+{
+    server.bzdb[name] = value;
+}
+
+void bzfsStub::setDebugLevel(int level)
+{
+    server.debugLevel = level;
+}
+
+void bzfsStub::setActivePlugin(bz_Plugin* plugin)
+{
+    server.plugin = plugin;
+}
+
+bool bzfsStub::runSlashCommand(int playerID, const std::string &command, const std::string &arguments)
+{
+    auto handler = server.slashCommands.find(command);
+
+    if (handler == server.slashCommands.end())
+    {
+        return false;
+    }
+
+    bz_APIStringList params;
+    size_t start = 0;
+
+    while (start < arguments.size())
+    {
+        size_t end = arguments.find(' ', start);
+
+        if (end == std::string::npos)
+        {
+            end = arguments.size();
+        }
+
+        if (end > start)
+        {
+            params.push_back(arguments.substr(start, end - start));
+        }
+
+        start = end + 1;
+    }
+
+    return handler->second->SlashCommand(playerID, command.c_str(), arguments.c_str(), &params);
+}
+
+uint64_t bzfsStub::messagesSent()
+{
+    return server.messagesSent;
+}
+
+//
+// bzfsAPI.h
+//
+
+class bz_ApiString::dataBlob
+{
+public:
+    std::string str;
+};
+
+bz_ApiString::bz_ApiString() : data(new dataBlob) {}
+bz_ApiString::bz_ApiString(const char* c) : data(new dataBlob) { data->str = c ? c : ""; }
+bz_ApiString::bz_ApiString(const std::string &s) : data(new dataBlob) { data->str = s; }
+bz_ApiString::bz_ApiString(const bz_ApiString &r) : data(new dataBlob) { data->str = r.data->str; }
+bz_ApiString::~bz_ApiString() { delete data; }
+
+size_t bz_ApiString::size(void) const { return data->str.size(); }
+bool bz_ApiString::empty(void) const { return data->str.empty(); }
+const char* bz_ApiString::c_str(void) const { return data->str.c_str(); }
+
+bz_ApiString& bz_ApiString::operator=(const bz_ApiString &r) { data->str = r.data->str; return *this; }
+bz_ApiString& bz_ApiString::operator=(const std::string &r) { data->str = r; return *this; }
+bz_ApiString& bz_ApiString::operator=(const char* r) { data->str = r ? r : ""; return *this; }
+
+bool bz_ApiString::operator==(const bz_ApiString &r) { return data->str == r.data->str; }
+bool bz_ApiString::operator==(const std::string &r) { return data->str == r; }
+bool bz_ApiString::operator==(const char* r) { return r && data->str == r; }
+bool bz_ApiString::operator!=(const bz_ApiString &r) { return !(*this == r); }
+bool bz_ApiString::operator!=(const std::string &r) { return !(*this == r); }
+bool bz_ApiString::operator!=(const char* r) { return !(*this == r); }
+
+void bz_ApiString::replaceAll(const char* target, const char* with)
+{
+    std::string needle = target;
+    size_t position = 0;
+
+    while (!needle.empty() && (position = data->str.find(needle, position)) != std::string::npos)
+    {
+        data->str.replace(position, needle.size(), with);
+        position += strlen(with);
+    }
+}
+
+void bz_ApiString::tolower(void)
+{
+    std::transform(data->str.begin(), data->str.end(), data->str.begin(), ::tolower);
+}
+
+class bz_APIIntList::dataBlob
+{
+public:
+    std::vector<int> list;
+};
+
+bz_APIIntList::bz_APIIntList() : data(new dataBlob) {}
+bz_APIIntList::~bz_APIIntList() { delete data; }
+void bz_APIIntList::push_back(int value) { data->list.push_back(value); }
+int bz_APIIntList::get(unsigned int i) { return data->list.at(i); }
+const int& bz_APIIntList::operator[](unsigned int i) const { return data->list.at(i); }
+unsigned int bz_APIIntList::size(void) { return (unsigned int)data->list.size(); }
+void bz_APIIntList::clear(void) { data->list.clear(); }
+
+class bz_APIStringList::dataBlob
+{
+public:
+    std::vector<bz_ApiString> list;
+};
+
+bz_APIStringList::bz_APIStringList() : data(new dataBlob) {}
+bz_APIStringList::~bz_APIStringList() { delete data; }
+void bz_APIStringList::push_back(const bz_ApiString &value) { data->list.push_back(value); }
+void bz_APIStringList::push_back(const std::string &value) { data->list.push_back(bz_ApiString(value)); }
+bz_ApiString bz_APIStringList::get(unsigned int i) const { return data->list.at(i); }
+const bz_ApiString& bz_APIStringList::operator[](unsigned int i) const { return data->list.at(i); }
+unsigned int bz_APIStringList::size(void) const { return (unsigned int)data->list.size(); }
+void bz_APIStringList::clear(void) { data->list.clear(); }
+
+bz_Plugin::bz_Plugin() : MaxWaitTime(-1), Unloadable(true) {}
+bz_Plugin::~bz_Plugin() {}
+bool bz_Plugin::Register(bz_eEventType /*eventType*/) { return true; }
+bool bz_Plugin::Remove(bz_eEventType /*eventType*/) { return true; }
+void bz_Plugin::Flush() {}
+
+double bz_getCurrentTime(void)
+{
+    return server.currentTime;
+}
+
+int bz_getTeamCount(bz_eTeamType team)
+{
+    return (int)std::count_if(server.players.begin(), server.players.end(), [team](const StubPlayer &p) {
+        return p.active && p.team == team;
+    });
+}
+
+int bz_getBZDBInt(const char* variable)
+{
+    return atoi(server.bzdb[variable].c_str());
+}
+
+bool bz_getBZDBBool(const char* variable)
+{
+    const std::string &value = server.bzdb[variable];
+
+    return value == "1" || value == "true";
+}
+
+double bz_getBZDBDouble(const char* variable)
+{
+    return atof(server.bzdb[variable].c_str());
+}
+
+bool bz_registerCustomBZDBInt(const char* variable, int value, int /*perms*/, bool /*persistent*/)
+{
+    return server.bzdb.insert(std::make_pair(variable, std::to_string(value))).second;
+}
+
+bool bz_registerCustomBZDBBool(const char* variable, bool value, int /*perms*/, bool /*persistent*/)
+{
+    return server.bzdb.insert(std::make_pair(variable, value ? "1" : "0")).second;
+}
+
+bool bz_registerCustomBZDBDouble(const char* variable, double value, int /*perms*/, bool /*persistent*/)
+{
+    return server.bzdb.insert(std::make_pair(variable, std::to_string(value))).second;
+}
+
+bool bz_removeCustomBZDBVariable(const char* name)
+{
+    return server.bzdb.erase(name) > 0;
+}
+
+bz_eTeamType bz_getPlayerTeam(int playerID)
+{
+    StubPlayer* player = findPlayer(playerID);
+
+    return player ? player->team : eNoTeam;
+}
+
+const char* bz_getPlayerCallsign(int playerID)
+{
+    StubPlayer* player = findPlayer(playerID);
+
+    return player ? player->callsign.c_str() : NULL;
+}
+
+bz_BasePlayerRecord* bz_getPlayerByIndex(int index)
+{
+    StubPlayer* player = findPlayer(index);
+
+    if (!player)
+    {
+        return NULL;
+    }
+
+    bz_BasePlayerRecord* record = new bz_BasePlayerRecord();
+    record->playerID = index;
+    record->callsign = player->callsign.c_str();
+    record->team = player->team;
+
+    return record;
+}
+
+bool bz_freePlayerRecord(bz_BasePlayerRecord* playerRecord)
+{
+    delete playerRecord;
+
+    return true;
+}
+
+bool bz_getPlayerIndexList(bz_APIIntList* playerList)
+{
+    playerList->clear();
+
+    for (size_t i = 0; i < server.players.size(); i++)
+    {
+        if (server.players[i].active)
+        {
+            playerList->push_back((int)i);
+        }
+    }
+
+    return true;
+}
+
+bool bz_incrementPlayerWins(int playerID, int increment)
+{
+    StubPlayer* player = findPlayer(playerID);
+
+    return player && (player->wins += increment, true);
+}
+
+bool bz_incrementPlayerLosses(int playerID, int increment)
+{
+    StubPlayer* player = findPlayer(playerID);
+
+    return player && (player->losses += increment, true);
+}
+
+int bz_getPlayerFlagID(int playerID)
+{
+    StubPlayer* player = findPlayer(playerID);
+
+    return player ? player->flagID : -1;
+}
+
+bool bz_removePlayerFlag(int playerID)
+{
+    StubPlayer* player = findPlayer(playerID);
+
+    if (!player || player->flagID < 0)
+    {
+        return false;
+    }
+
+    player->flagID = -1;
+
+    return true;
+}
+
+int bz_getNumFlags(void)
+{
+    return (int)server.flags.size();
+}
+
+bool bz_getNearestFlagSafetyZone(int flag, float* pos)
+{
+    if (flag < 0 || flag >= (int)server.flags.size())
+    {
+        return false;
+    }
+
+    pos[0] = pos[1] = pos[2] = 0;
+
+    return true;
+}
+
+bool bz_moveFlag(int flag, float pos[3], bool /*reset*/)
+{
+    if (flag < 0 || flag >= (int)server.flags.size())
+    {
+        return false;
+    }
+
+    std::copy(pos, pos + 3, server.flags[flag].position);
+
+    return true;
+}
+
+bool bz_sendTextMessage(int /*from*/, int /*to*/, const char* /*message*/)
+{
+    server.messagesSent++;
+
+    return true;
+}
+
+bool bz_sendTextMessagef(int /*from*/, int /*to*/, const char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(server.formatBuffer, sizeof(server.formatBuffer), fmt, args);
+    va_end(args);
+
+    server.messagesSent++;
+
+    return true;
+}
+
+void bz_debugMessage(int debugLevel, const char* message)
+{
+    if (debugLevel <= server.debugLevel)
+    {
+        fprintf(stderr, "%s\n", message);
+    }
+}
+
+void bz_debugMessagef(int debugLevel, const char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(server.formatBuffer, sizeof(server.formatBuffer), fmt, args);
+    va_end(args);
+
+    bz_debugMessage(debugLevel, server.formatBuffer);
+}
+
+int bz_getDebugLevel(void)
+{
+    return server.debugLevel;
+}
+
+const char* bz_format(const char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(server.formatBuffer, sizeof(server.formatBuffer), fmt, args);
+    va_end(args);
+
+    return server.formatBuffer;
+}
+
+const char* bz_trim(const char* val, const char* trim)
+{
+    static thread_local std::string result;
+
+    result = val ? val : "";
+
+    size_t first = result.find_first_not_of(trim);
+    size_t last = result.find_last_not_of(trim);
+
+    result = (first == std::string::npos) ? "" : result.substr(first, last - first + 1);
+
+    return result.c_str();
+}
+
+bool bz_hasPerm(int playerID, const char* /*perm*/)
+{
+    // Everyone is an administrator so the offline tools can exercise admin-only commands
+    return playerID == BZ_SERVER || findPlayer(playerID) != NULL;
+}
+
+bool bz_setclipFieldString(const char* name, const char* data)
+{
+    server.clipFields[name] = data;
+
+    return true;
+}
+
+const char* bz_getclipFieldString(const char* name)
+{
+    auto field = server.clipFields.find(name);
+
+    return (field == server.clipFields.end()) ? NULL : field->second.c_str();
+}
+
+bool bz_pluginExists(const char* name)
+{
+    return server.plugin && name && strcmp(server.plugin->Name(), name) == 0;
+}
+
+int bz_callPluginGenericCallback(const char* plugin, const char* name, void* data)
+{
+    return bz_pluginExists(plugin) ? server.plugin->GeneralCallback(name, data) : 0;
+}
+
+bool bz_registerCustomSlashCommand(const char* command, bz_CustomSlashCommandHandler* handler)
+{
+    server.slashCommands[command] = handler;
+
+    return true;
+}
+
+bool bz_removeCustomSlashCommand(const char* command)
+{
+    return server.slashCommands.erase(command) > 0;
+}
+
+//
+// plugin_utils.h
+//
+
+const char* bzu_GetTeamName(bz_eTeamType team)
+{
+    switch (team)
+    {
+        case eRogueTeam:  return "Rogue";
+        case eRedTeam:    return "Red";
+        case eGreenTeam:  return "Green";
+        case eBlueTeam:   return "Blue";
+        case ePurpleTeam: return "Purple";
+        case eRabbitTeam: return "Rabbit";
+        case eHunterTeam: return "Hunter";
+        case eObservers:  return "Observer";
+        default:          return "No Team";
+    }
+}
+
+bz_eTeamType bzu_getTeamFromFlag(const char* flagCode)
+{
+    if (!flagCode || flagCode[0] == '\0' || flagCode[1] != '*')
+    {
+        return eNoTeam;
+    }
+
+    switch (flagCode[0])
+    {
+        case 'R': return eRedTeam;
+        case 'G': return eGreenTeam;
+        case 'B': return eBlueTeam;
+        case 'P': return ePurpleTeam;
+        default:  return eNoTeam;
+    }
+}
+
+static std::string stubLowercase(std::string value)
+{
+    std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+
+    return value;
+}
+
+static std::string stubTrim(const std::string &value)
+{
+    size_t first = value.find_first_not_of(" \t\r\n");
+    size_t last = value.find_last_not_of(" \t\r\n");
+
+    return (first == std::string::npos) ? "" : value.substr(first, last - first + 1);
+}
+
+// The parsed file lives in PluginConfig's own `sections` member, so it's freed with the object and configurations
+// parsed on different threads never share any state
+
+PluginConfig::PluginConfig() : errors(0)
+{
+}
+
+PluginConfig::PluginConfig(const std::string &filename) : errors(0)
+{
+    read(filename);
+}
+
+void PluginConfig::read(const std::string &filename)
+{
+    std::ifstream file(filename.c_str());
+    std::string line;
+    std::string section;
+
+    sections.clear();
+
+    if (!file)
+    {
+        errors++;
+        return;
+    }
+
+    while (std::getline(file, line))
+    {
+        line = stubTrim(line);
+
+        if (line.empty() || line[0] == '#' || line[0] == ';')
+        {
+            continue;
+        }
+
+        if (line[0] == '[')
+        {
+            section = stubLowercase(stubTrim(line.substr(1, line.find(']') - 1)));
+            continue;
+        }
+
+        size_t equals = line.find('=');
+
+        if (equals == std::string::npos)
+        {
+            errors++;
+            continue;
+        }
+
+        sections[section][stubLowercase(stubTrim(line.substr(0, equals)))] = stubTrim(line.substr(equals + 1));
+    }
+}
+
+std::string PluginConfig::item(const std::string &section, const std::string &key)
+{
+    auto items = sections.find(stubLowercase(section));
+
+    if (items == sections.end())
+    {
+        return "";
+    }
+
+    auto value = items->second.find(stubLowercase(key));
+
+    return (value == items->second.end()) ? "" : value->second;
+}
+
+std::vector<std::string> PluginConfig::getSections()
+{
+    std::vector<std::string> names;
+
+    for (auto &section : sections)
+    {
+        names.push_back(section.first);
+    }
+
+    return names;
+}
+
+std::vector<std::pair<std::string, std::string>> PluginConfig::getSectionItems(const std::string &section)
+{
+    std::vector<std::pair<std::string, std::string>> items;
+
+    for (auto &item : sections[stubLowercase(section)])
+    {
+        items.push_back(item);
+    }
+
+    return items;
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2019 Vladimir "allejo" Jimenez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CTFOVERSEER_STUBS_H
+#define CTFOVERSEER_STUBS_H
+
+#include <stdint.h>
+#include <string>
+
+#include "bzfsAPI.h"
+
+/**
+ * Controls for the stand-in implementation of the bzfsAPI.h and plugin_utils functions used by CTF Overseer. This lets
+ * the offline tools drive the plug-in's event handlers without a running bzfs; it is never linked into the plug-in.
+ */
+namespace bzfsStub
+{
+    /// Forget every player, flag, BZDB variable and counter and rewind the clock to 0
+    void reset();
+
+    /// The value returned by bz_getCurrentTime()
+    void setCurrentTime(double time);
+    void advanceTime(double seconds);
+
+    /// Add a player to the given team and return their player ID, or -1 if the server is full
+    int addPlayer(bz_eTeamType team, const char* callsign);
+    void removePlayer(int playerID);
+    void setPlayerTeam(int playerID, bz_eTeamType team);
+
+    /// Add a flag to the world (e.g. "R*" for the red team flag) and return its flag ID
+    int addFlag(const char* flagType);
+    void setPlayerFlag(int playerID, int flagID);
+
+    void setBZDB(const std::string &name, const std::string &value);
+    void setDebugLevel(int level);
+
+    /// The plug-in that bz_getclipFieldString, bz_pluginExists and bz_callPluginGenericCallback resolve to
+    void setActivePlugin(bz_Plugin* plugin);
+
+    /// Invoke a slash command registered with bz_registerCustomSlashCommand; returns false if nobody handled it
+    bool runSlashCommand(int playerID, const std::string &command, const std::string &arguments);
+
+    /// The number of text messages sent through bz_sendTextMessage(f) since the last reset
+    uint64_t messagesSent();
+}
+
+#endif